@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+#-------------------------------------------------------------------------------
+#
+#    Binary logger (z7blog.h) decoder
+#
+#    Usage:
+#
+#        blogdec.py app.elf log.bin
+#        blogdec.py app.elf /dev/ttyUSB0 --baud 921600      (requires pyserial)
+#
+#    Format strings are taken from .blog_fmt section of the application ELF
+#    file, string address is the format ID of the record.
+#
+#-------------------------------------------------------------------------------
+
+import argparse
+import re
+import struct
+import sys
+
+SYNC = 0xa5
+
+#-------------------------------------------------------------------------------
+def load_formats(elf_path):
+    with open(elf_path, 'rb') as f:
+        elf = f.read()
+
+    if elf[:4] != b'\x7fELF':
+        sys.exit('%s: not an ELF file' % elf_path)
+
+    is64 = elf[4] == 2
+    end  = '<' if elf[5] == 1 else '>'
+
+    if is64:
+        shoff, = struct.unpack_from(end + 'Q', elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', elf, 0x3a)
+        sh_fmt = end + 'IIQQQQIIQQ'
+    else:
+        shoff, = struct.unpack_from(end + 'I', elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + 'HHH', elf, 0x2e)
+        sh_fmt = end + 'IIIIIIIIII'
+
+    sections = [struct.unpack_from(sh_fmt, elf, shoff + i*shentsize) for i in range(shnum)]
+    strtab   = sections[shstrndx]
+    names    = elf[strtab[4]:strtab[4] + strtab[5]]
+
+    for sh in sections:
+        name = names[sh[0]:names.index(b'\0', sh[0])].decode()
+        if name == '.blog_fmt':
+            addr, offset, size = sh[3], sh[4], sh[5]
+            return addr, elf[offset:offset + size]
+
+    sys.exit('%s: no .blog_fmt section' % elf_path)
+
+#-------------------------------------------------------------------------------
+SPEC = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXcfeEgGps%])')
+
+def parse_format(fmt):
+    """Returns Python format string and list of (kind, words) per argument"""
+    args = []
+
+    def conv(m):
+        flags, length, c = m.groups()
+        if c == '%':
+            return '%%'
+        if c in 'di':
+            args.append(('s64' if length == 'll' else 's32', 2 if length == 'll' else 1))
+            return '%' + flags + 'd'
+        if c in 'ouxX':
+            args.append(('u64' if length == 'll' else 'u32', 2 if length == 'll' else 1))
+            return '%' + flags + c
+        if c == 'c':
+            args.append(('u32', 1))
+            return '%c'
+        if c in 'feEgG':
+            args.append(('f32', 1))
+            return '%' + flags + c
+        if c == 'p':
+            args.append(('u32', 1))
+            return '0x%08x'
+        args.append(('u32', 1))                     # %s: only the pointer is logged
+        return '<str@0x%08x>'
+
+    return SPEC.sub(conv, fmt), args
+
+#-------------------------------------------------------------------------------
+def format_record(formats, words):
+    base, data = formats
+    fid  = words[0]
+    off  = fid - base
+    if off < 0 or off >= len(data):
+        return '<unknown format id 0x%08x>' % fid
+
+    fmt = data[off:data.index(b'\0', off)].decode(errors='replace')
+    pyfmt, specs = parse_format(fmt)
+
+    vals = []
+    pos  = 1
+    for kind, n in specs:
+        if pos + n > len(words):
+            return fmt + '  <missing arguments>'
+        w = words[pos:pos + n]
+        pos += n
+        if kind == 'u32':
+            vals.append(w[0])
+        elif kind == 's32':
+            vals.append(struct.unpack('<i', struct.pack('<I', w[0]))[0])
+        elif kind == 'u64':
+            vals.append(w[0] | (w[1] << 32))
+        elif kind == 's64':
+            vals.append(struct.unpack('<q', struct.pack('<Q', w[0] | (w[1] << 32)))[0])
+        else:
+            vals.append(struct.unpack('<f', struct.pack('<I', w[0]))[0])
+
+    try:
+        return pyfmt % tuple(vals)
+    except (TypeError, ValueError, OverflowError):
+        return fmt + '  ' + repr(vals)
+
+#-------------------------------------------------------------------------------
+def decode(formats, stream, out):
+    buf      = b''
+    last_seq = None
+
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+
+        while len(buf) >= 4:
+            hdr, = struct.unpack_from('<I', buf)
+            count = (hdr >> 16) & 0xff
+            if hdr >> 24 != SYNC or count == 0:
+                buf = buf[1:]                       # resync
+                continue
+            if len(buf) < 4*(count + 1):
+                break
+
+            words = struct.unpack_from('<%dI' % count, buf, 4)
+            buf   = buf[4*(count + 1):]
+
+            seq = hdr & 0xffff
+            if last_seq is not None and seq != (last_seq + 1) & 0xffff:
+                out.write('<%d records lost>\n' % ((seq - last_seq - 1) & 0xffff))
+            last_seq = seq
+
+            out.write('%5d: %s\n' % (seq, format_record(formats, words)))
+        out.flush()
+
+#-------------------------------------------------------------------------------
+def main():
+    ap = argparse.ArgumentParser(description='z7blog binary log decoder')
+    ap.add_argument('elf',    help='application ELF file')
+    ap.add_argument('input',  help='binary log file or serial port, "-" for stdin')
+    ap.add_argument('--baud', type=int, default=115200, help='serial port baud rate')
+    args = ap.parse_args()
+
+    formats = load_formats(args.elf)
+
+    if args.input == '-':
+        stream = sys.stdin.buffer
+    elif args.input.startswith('/dev/') or args.input.upper().startswith('COM'):
+        import serial
+        stream = serial.Serial(args.input, args.baud, timeout=None)
+    else:
+        stream = open(args.input, 'rb')
+
+    try:
+        decode(formats, stream, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == '__main__':
+    main()
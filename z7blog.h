@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi Binary Logger Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7BLOG_H
+#define PS7BLOG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <z7int.h>
+#include "z7ring.h"
+
+//------------------------------------------------------------------------------
+//
+//    Deferred-formatting binary logger
+//
+//    Notes:
+//    ~~~~~
+//    BLOG() stores only format string ID and raw argument words into a ring
+//    buffer, the text is built on the host by tools/blogdec.py from the ELF
+//    file of the application. Format strings are placed in .blog_fmt section,
+//    string address is its ID. The section should be described in the linker
+//    script as non-loadable, so the strings take no target memory:
+//
+//        .blog_fmt 0 (INFO) : { KEEP(*(.blog_fmt)) }
+//
+//    Record format (32-bit little-endian words):
+//
+//        [31:24] SYNC, [23:16] number of words after the header, [15:0] seq
+//        format string ID
+//        arguments: integers and pointers up to 32 bits - one word, 64-bit
+//        integers - two words (low first), floating point - one word (float)
+//
+//    %s is not supported: string contents are not in the record.
+//
+//    The record is put into the ring inside critical section, so BLOG() can be
+//    used from any thread and ISR; if there is no space, the record is dropped
+//    and counted, sequence number gap shows the loss on the host. drain() is
+//    called from background (single consumer) and sends the words to buffered
+//    UART (BufUart or any class with tx_free() and write()).
+//
+//    Usage example:
+//
+//        BinLog<1024> blog;
+//        ...
+//        BLOG(blog, "adc ch%u: %d, t = %f", ch, val, temp);
+//        ...
+//        for(;;) { blog.drain(uart1); ... }
+//
+#define BLOG(log, fmt, ...)                                                                   \
+    do                                                                                        \
+    {                                                                                         \
+        static const char blog_fmt_[] __attribute__((section(".blog_fmt"), used)) = fmt;     \
+        (log).write(reinterpret_cast<uintptr_t>(blog_fmt_), ##__VA_ARGS__);                   \
+    } while(0)
+
+//------------------------------------------------------------------------------
+template<uint32_t SIZE = 1024>        // words
+class BinLog
+{
+public:
+    static const uint32_t SYNC       = 0xa5;
+    static const uint32_t MAX_ARGS   = 16;      // words
+
+public:
+    BinLog() : seq(0), dropped(0) { }
+
+    template<typename... Args>
+    INLINE void write(const uintptr_t id, const Args&... args)
+    {
+        const uint32_t WORDS = 1 + arg_words<Args...>();
+        static_assert(WORDS <= MAX_ARGS + 1, "too many BLOG arguments");
+
+        uint32_t rec[WORDS + 1];
+        rec[1] = id;
+        put(&rec[2], args...);
+
+        CritSect cs;
+
+        if(ring.free() < WORDS + 1)
+        {
+            ++dropped;
+            ++seq;
+            return;
+        }
+        rec[0] = (SYNC << 24) + (WORDS << 16) + (seq++ & 0xffff);
+        ring.write(rec, WORDS + 1);
+    }
+
+    //  sends whole words only, returns number of words sent
+    template<typename U>
+    uint32_t drain(U &uart)
+    {
+        const uint32_t CHUNK = 16;
+
+        uint32_t sent = 0;
+        for(;;)
+        {
+            uint32_t n = uart.tx_free()/sizeof(uint32_t);
+            if(n > CHUNK)
+            {
+                n = CHUNK;
+            }
+
+            uint32_t buf[CHUNK];
+            n = ring.read(buf, n);
+            if(!n)
+                return sent;
+
+            uart.write(buf, n*sizeof(uint32_t));
+            sent += n;
+        }
+    }
+
+    uint32_t lost() const { return dropped; }
+
+private:
+    template<typename T>
+    static constexpr uint32_t words_of()
+    {
+        return std::is_floating_point<T>::value ? 1 : (sizeof(T) + 3)/4;
+    }
+
+    template<typename... Args>
+    static constexpr typename std::enable_if<sizeof...(Args) == 0, uint32_t>::type arg_words() { return 0; }
+
+    template<typename T, typename... Rest>
+    static constexpr uint32_t arg_words() { return words_of<T>() + arg_words<Rest...>(); }
+
+    INLINE static void put(uint32_t *) { }
+
+    template<typename T, typename... Rest>
+    INLINE static void put(uint32_t *p, const T &v, const Rest&... rest)
+    {
+        put_arg(p, v);
+        put(p + words_of<T>(), rest...);
+    }
+
+    template<typename T>
+    INLINE static typename std::enable_if<std::is_floating_point<T>::value>::type put_arg(uint32_t *p, const T &v)
+    {
+        const float f = v;
+        memcpy(p, &f, sizeof(f));
+    }
+
+    template<typename T>
+    INLINE static typename std::enable_if<!std::is_floating_point<T>::value && sizeof(T) <= 4>::type put_arg(uint32_t *p, const T &v)
+    {
+        *p = (uint32_t)(v);
+    }
+
+    template<typename T>
+    INLINE static typename std::enable_if<!std::is_floating_point<T>::value && sizeof(T) == 8>::type put_arg(uint32_t *p, const T &v)
+    {
+        const uint64_t x = (uint64_t)(v);
+        p[0] = x;
+        p[1] = x >> 32;
+    }
+
+private:
+    RingBuffer<uint32_t, SIZE> ring;
+    uint32_t                   seq;
+    uint32_t                   dropped;
+};
+//------------------------------------------------------------------------------
+
+#endif // PS7BLOG_H
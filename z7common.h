@@ -90,6 +90,69 @@ INLINE void set_vbar(void *addr)
   __asm__ __volatile__ ("mcr p15, 0, %0, c12, c0, 0" :  : "r" (addr));
 }
 
+//------------------------------------------------------------------------------
+//
+//    Data cache maintenance by address range (L1 and L2)
+//
+//        clean:      write back dirty lines, required before DMA reads memory
+//        invalidate: drop lines, required after DMA writes memory
+//        flush:      clean and invalidate
+//
+#ifdef __cplusplus
+const uint32_t  CACHE_LINE_SIZE  = 32;
+
+const uintptr_t L2C_SYNC_REG     = 0xf8f02730;
+const uintptr_t L2C_INV_PA_REG   = 0xf8f02770;
+const uintptr_t L2C_CLEAN_PA_REG = 0xf8f027b0;
+const uintptr_t L2C_FLUSH_PA_REG = 0xf8f027f0;
+
+INLINE void dcache_clean_line(uintptr_t addr) { __asm__ __volatile__ ("mcr p15, 0, %0, c7, c10, 1" : : "r" (addr) : "memory"); }
+INLINE void dcache_inv_line  (uintptr_t addr) { __asm__ __volatile__ ("mcr p15, 0, %0, c7, c6,  1" : : "r" (addr) : "memory"); }
+INLINE void dcache_flush_line(uintptr_t addr) { __asm__ __volatile__ ("mcr p15, 0, %0, c7, c14, 1" : : "r" (addr) : "memory"); }
+//------------------------------------------------------------------------------
+INLINE void dcache_clean(const void *p, const uint32_t size)
+{
+    const uintptr_t end = reinterpret_cast<uintptr_t>(p) + size;
+
+    for(uintptr_t addr = reinterpret_cast<uintptr_t>(p) & ~(CACHE_LINE_SIZE - 1); addr < end; addr += CACHE_LINE_SIZE)
+    {
+        dcache_clean_line(addr);
+        __dsb();
+        wpa(L2C_CLEAN_PA_REG, addr);
+    }
+    wpa(L2C_SYNC_REG, 0);
+    __dsb();
+}
+//------------------------------------------------------------------------------
+INLINE void dcache_invalidate(const void *p, const uint32_t size)
+{
+    const uintptr_t end = reinterpret_cast<uintptr_t>(p) + size;
+
+    for(uintptr_t addr = reinterpret_cast<uintptr_t>(p) & ~(CACHE_LINE_SIZE - 1); addr < end; addr += CACHE_LINE_SIZE)
+    {
+        wpa(L2C_INV_PA_REG, addr);
+        wpa(L2C_SYNC_REG, 0);
+        dcache_inv_line(addr);
+    }
+    __dsb();
+}
+//------------------------------------------------------------------------------
+INLINE void dcache_flush(const void *p, const uint32_t size)
+{
+    const uintptr_t end = reinterpret_cast<uintptr_t>(p) + size;
+
+    for(uintptr_t addr = reinterpret_cast<uintptr_t>(p) & ~(CACHE_LINE_SIZE - 1); addr < end; addr += CACHE_LINE_SIZE)
+    {
+        dcache_clean_line(addr);
+        __dsb();
+        wpa(L2C_FLUSH_PA_REG, addr);
+        wpa(L2C_SYNC_REG, 0);
+        dcache_inv_line(addr);
+    }
+    __dsb();
+}
+#endif // __cplusplus
+
 
 //------------------------------------------------------------------------------
 #ifdef __cplusplus
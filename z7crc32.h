@@ -0,0 +1,64 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi CRC-32 Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7CRC32_H
+#define PS7CRC32_H
+
+#include <stdint.h>
+
+#ifndef INLINE
+#define INLINE __attribute__((__always_inline__)) inline
+#endif
+
+//------------------------------------------------------------------------------
+//
+//    CRC-32 (IEEE 802.3, reflected polynomial 0xedb88320), table-driven
+//
+//    Notes:
+//    ~~~~~
+//    crc32() is chainable: the result of the previous call is passed as 'crc'
+//    argument to continue the calculation over the next block, the initial
+//    value is 0. The result is compatible with zlib crc32().
+//
+//    crc32_byte() operates on the raw (inverted) register value and is intended
+//    for fused loops: start from ~0, pass each byte, invert the final value.
+//
+extern const uint32_t CRC32_TABLE[256];
+
+INLINE uint32_t crc32_byte(const uint32_t crc, const uint8_t b)
+{
+    return CRC32_TABLE[(crc ^ b) & 0xff] ^ (crc >> 8);
+}
+//------------------------------------------------------------------------------
+uint32_t crc32(const void *data, const uint32_t count, const uint32_t crc = 0);
+//------------------------------------------------------------------------------
+
+#endif  // PS7CRC32_H
@@ -0,0 +1,428 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi DMA Controller (PL330) Support Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <z7dmac.h>
+
+//------------------------------------------------------------------------------
+//
+//    Beats per burst for memory-to-memory transfers
+//
+static const uint32_t BURST_LEN = 16;
+
+//------------------------------------------------------------------------------
+void Dmac::Program::mov(const MovReg r, const uint32_t val)
+{
+    emit(opMOV);
+    emit(r);
+    emit(val);
+    emit(val >> 8);
+    emit(val >> 16);
+    emit(val >> 24);
+}
+//------------------------------------------------------------------------------
+void Dmac::Program::lp(const uint32_t lc, const uint32_t iter)
+{
+    emit(opLP + (lc << 1));
+    emit(iter - 1);
+}
+//------------------------------------------------------------------------------
+void Dmac::Program::lpend(const uint32_t lc, const uint32_t start)
+{
+    const uint32_t jump = pos - start;    // backward jump to the loop body
+
+    emit(opLPEND + (lc << 2));
+    emit(jump);
+}
+//------------------------------------------------------------------------------
+//
+//    Loop counters are 8 bit wide, so count is split to nested loops
+//    of up to 256*256 iterations
+//
+template<typename F> void Dmac::Program::loop(uint32_t count, F body)
+{
+    while(count >= 256)
+    {
+        uint32_t outer = count/256;
+        if(outer > 256)
+        {
+            outer = 256;
+        }
+
+        lp(1, outer);
+        const uint32_t start1 = pos;
+        lp(0, 256);
+        const uint32_t start0 = pos;
+        body();
+        lpend(0, start0);
+        lpend(1, start1);
+
+        count -= outer*256;
+    }
+
+    if(count)
+    {
+        lp(0, count);
+        const uint32_t start0 = pos;
+        body();
+        lpend(0, start0);
+    }
+}
+//------------------------------------------------------------------------------
+void Dmac::init()
+{
+    slcr_unlock();
+    sbpa(DMAC_RST_CTRL_REG, DMAC_RST_CTRL_DMAC_RST_MASK);
+    cbpa(DMAC_RST_CTRL_REG, DMAC_RST_CTRL_DMAC_RST_MASK);
+    slcr_lock();
+
+    for(uint32_t i = 0; i < CHANNELS; ++i)
+    {
+        chan[i].busy = false;
+    }
+    allocated = 0;
+
+    regs->INTEN  = (1ul << CHANNELS) - 1;   // events 0..7 -> interrupts, 8..15 -> events
+    regs->INTCLR = (1ul << CHANNELS) - 1;
+}
+//------------------------------------------------------------------------------
+int Dmac::alloc()
+{
+    for(uint32_t i = 0; i < CHANNELS; ++i)
+    {
+        if( !(allocated & (1ul << i)) )
+        {
+            allocated |= 1ul << i;
+            return i;
+        }
+    }
+    return -1;
+}
+//------------------------------------------------------------------------------
+bool Dmac::copy(const uint32_t ch, void *dst, const void *src, const uint32_t size, callback_t cb, void *ctx)
+{
+    if(ch >= CHANNELS || chan[ch].busy)
+        return false;
+
+    Segment &seg = chan[ch].seg;
+    seg.dst  = reinterpret_cast<uintptr_t>(dst);
+    seg.src  = reinterpret_cast<uintptr_t>(src);
+    seg.size = size;
+
+    return copy_sg(ch, &seg, 1, cb, ctx);
+}
+//------------------------------------------------------------------------------
+bool Dmac::copy_sg(const uint32_t ch, const Segment *sg, const uint32_t count, callback_t cb, void *ctx)
+{
+    if(ch >= CHANNELS || chan[ch].busy)
+        return false;
+
+    Program prg(prog[ch]);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        gen_copy(prg, sg[i]);
+    }
+    prg.op(opWMB);
+    prg.op(opSEV, ch << 3);
+    prg.op(opEND);
+
+    if(!prg.fits(0))
+        return false;
+
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        dcache_clean(reinterpret_cast<const void *>(sg[i].src), sg[i].size);
+        dcache_flush(reinterpret_cast<const void *>(sg[i].dst), sg[i].size);
+    }
+
+    setup(ch, cb, ctx, 0, 0);
+    chan[ch].chunks   = 1;
+    chan[ch].sg       = sg;
+    chan[ch].sg_count = count;
+
+    return start(ch, prg);
+}
+//------------------------------------------------------------------------------
+bool Dmac::to_fifo(const uint32_t   ch,
+                   volatile void   *fifo,
+                   const void      *src,
+                   const uint32_t   size,
+                   const uint32_t   chunk,
+                   pace_t           pace,
+                   void            *pctx,
+                   callback_t       cb,
+                   void            *ctx)
+{
+    if(ch >= CHANNELS || chan[ch].busy)
+        return false;
+
+    Segment &seg = chan[ch].seg;
+    seg.dst  = reinterpret_cast<uintptr_t>(fifo);
+    seg.src  = reinterpret_cast<uintptr_t>(src);
+    seg.size = size;
+
+    dcache_clean(src, size);
+
+    setup(ch, cb, ctx, pace, pctx);
+    chan[ch].sg_count = 0;
+
+    return gen_fifo(ch, seg, true, chunk);
+}
+//------------------------------------------------------------------------------
+bool Dmac::from_fifo(const uint32_t   ch,
+                     void            *dst,
+                     volatile void   *fifo,
+                     const uint32_t   size,
+                     const uint32_t   chunk,
+                     pace_t           pace,
+                     void            *pctx,
+                     callback_t       cb,
+                     void            *ctx)
+{
+    if(ch >= CHANNELS || chan[ch].busy)
+        return false;
+
+    Segment &seg = chan[ch].seg;
+    seg.dst  = reinterpret_cast<uintptr_t>(dst);
+    seg.src  = reinterpret_cast<uintptr_t>(fifo);
+    seg.size = size;
+
+    dcache_flush(dst, size);
+
+    setup(ch, cb, ctx, pace, pctx);
+    chan[ch].sg       = &seg;
+    chan[ch].sg_count = 1;
+
+    return gen_fifo(ch, seg, false, chunk);
+}
+//------------------------------------------------------------------------------
+void Dmac::abort(const uint32_t ch)
+{
+    if(!chan[ch].busy)
+        return;
+
+    exec( (opKILL << 16) + (ch << 8) + 1, 0 );  // DMAKILL on channel thread
+    finish(ch, evFAULT);
+}
+//------------------------------------------------------------------------------
+void Dmac::isr()
+{
+    uint32_t pending = regs->INTMIS & ((1ul << CHANNELS) - 1);
+
+    while(pending)
+    {
+        const uint32_t ch = 31 - __clz(pending);
+
+        pending      &= ~(1ul << ch);
+        regs->INTCLR  =   1ul << ch;
+
+        Channel &c = chan[ch];
+        if(--c.chunks)
+        {
+            if(c.pace)
+            {
+                c.pace(c.pctx);
+            }
+        }
+        else
+        {
+            finish(ch, evDONE);
+        }
+    }
+}
+//------------------------------------------------------------------------------
+void Dmac::abort_isr()
+{
+    uint32_t faults = regs->FSRC & ((1ul << CHANNELS) - 1);
+
+    while(faults)
+    {
+        const uint32_t ch = 31 - __clz(faults);
+
+        faults &= ~(1ul << ch);
+        exec( (opKILL << 16) + (ch << 8) + 1, 0 );
+        finish(ch, evFAULT);
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    CCR: [0]     SI  source increment
+//         [3:1]   SB  source burst size, log2(bytes)
+//         [7:4]   SL  source burst length - 1
+//         [14]    DI  destination increment
+//         [17:15] DB  destination burst size
+//         [21:18] DL  destination burst length - 1
+//
+//    Protection and cache control fields are 0: secure, non-cacheable access
+//
+uint32_t Dmac::ccr(const uint32_t src_inc, const uint32_t dst_inc, const uint32_t size, const uint32_t len)
+{
+    return  src_inc
+         + (size      << 1)
+         + ((len - 1) << 4)
+         + (dst_inc   << 14)
+         + (size      << 15)
+         + ((len - 1) << 18);
+}
+//------------------------------------------------------------------------------
+void Dmac::gen_copy(Program &prg, const Segment &seg)
+{
+    const uint32_t ALIGN = seg.dst | seg.src;
+    const uint32_t SIZE  = ALIGN % 8 == 0 ? 3 : ALIGN % 4 == 0 ? 2 : 0;
+    const uint32_t BURST = (1ul << SIZE)*BURST_LEN;
+
+    const uint32_t bursts = seg.size/BURST;
+    const uint32_t rest   = seg.size%BURST;
+
+    prg.mov(rSAR, seg.src);
+    prg.mov(rDAR, seg.dst);
+
+    if(bursts)
+    {
+        prg.mov(rCCR, ccr(1, 1, SIZE, BURST_LEN));
+        prg.loop(bursts, [&prg]() { prg.op(opLD); prg.op(opST); });
+    }
+
+    if(rest)
+    {
+        prg.mov(rCCR, ccr(1, 1, 0, 1));
+        prg.loop(rest,   [&prg]() { prg.op(opLD); prg.op(opST); });
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Peripheral FIFO program: single byte beats, peripheral side address is
+//    fixed; each chunk is preceded by waiting for the pacing event and followed
+//    by the channel event which calls 'pace' hook (the last one completes
+//    the transfer)
+//
+bool Dmac::gen_fifo(const uint32_t ch, const Segment &seg, const bool tx, const uint32_t chunk)
+{
+    if(!seg.size || !chunk || chunk > 256)
+        return false;
+
+    Program prg(prog[ch]);
+
+    const uint32_t PACE_EV = pace_event(ch) << 3;
+    const uint32_t DONE_EV = ch << 3;
+
+    uint32_t chunks = seg.size/chunk;
+    uint32_t rest   = seg.size%chunk;
+
+    chan[ch].chunks = chunks + (rest ? 1 : 0);
+
+    prg.mov(rSAR, seg.src);
+    prg.mov(rDAR, seg.dst);
+    prg.mov(rCCR, tx ? ccr(1, 0, 0, 1) : ccr(0, 1, 0, 1));
+
+    while(chunks)
+    {
+        const uint32_t n = chunks > 256 ? 256 : chunks;
+
+        prg.lp(1, n);
+        const uint32_t start1 = prg.size();
+        prg.op(opWFE, PACE_EV);
+        prg.lp(0, chunk);                           // LC1 counts chunks, so the
+        const uint32_t start0 = prg.size();         // inner loop is LC0 only
+        prg.op(opLD);
+        prg.op(opST);
+        prg.lpend(0, start0);
+        prg.op(opWMB);
+        prg.op(opSEV, DONE_EV);
+        prg.lpend(1, start1);
+
+        chunks -= n;
+    }
+
+    if(rest)
+    {
+        prg.op(opWFE, PACE_EV);
+        prg.loop(rest, [&prg]() { prg.op(opLD); prg.op(opST); });
+        prg.op(opWMB);
+        prg.op(opSEV, DONE_EV);
+    }
+    prg.op(opEND);
+
+    if(!prg.fits(0))
+        return false;
+
+    return start(ch, prg);
+}
+//------------------------------------------------------------------------------
+bool Dmac::start(const uint32_t ch, const Program &prg)
+{
+    dcache_clean(prog[ch], prg.size());
+
+    chan[ch].busy = true;
+    exec( (ch << 24) + (opGO << 16), reinterpret_cast<uintptr_t>(prog[ch]) );
+
+    return true;
+}
+//------------------------------------------------------------------------------
+//
+//    Executes instruction via debug interface on the manager thread (bit 0
+//    of inst0 is 0) or on channel thread (bit 0 is 1, channel in [10:8]),
+//    inst0[31:16] holds instruction bytes 1:0, inst1 - bytes 5:2
+//
+void Dmac::exec(const uint32_t inst0, const uint32_t inst1)
+{
+    while(regs->DBGSTATUS & 1) { }
+
+    regs->DBGINST0 = inst0;
+    regs->DBGINST1 = inst1;
+    regs->DBGCMD   = 0;
+}
+//------------------------------------------------------------------------------
+void Dmac::setup(const uint32_t ch, callback_t cb, void *ctx, pace_t pace, void *pctx)
+{
+    Channel &c = chan[ch];
+
+    c.cb   = cb;
+    c.ctx  = ctx;
+    c.pace = pace;
+    c.pctx = pctx;
+}
+//------------------------------------------------------------------------------
+void Dmac::finish(const uint32_t ch, const Event ev)
+{
+    Channel &c = chan[ch];
+
+    for(uint32_t i = 0; i < c.sg_count; ++i)
+    {
+        dcache_invalidate(reinterpret_cast<const void *>(c.sg[i].dst), c.sg[i].size);
+    }
+    c.busy = false;
+
+    if(c.cb)
+    {
+        c.cb(c.ctx, ch, ev);
+    }
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,271 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi DMA Controller (PL330) Support Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7DMAC_H
+#define PS7DMAC_H
+
+#include <stdint.h>
+#include <ps7mmrs.h>
+#include <z7common.h>
+
+//------------------------------------------------------------------------------
+//
+//    DMA Controller (ARM PL330)
+//
+//    Notes:
+//    ~~~~~
+//    Each of 8 DMA channels executes its own microcode program generated by
+//    the driver into a per-channel buffer. Programs are started by DMAGO
+//    issued from the manager thread through the debug instruction registers.
+//
+//    Events 0..7 are used for completion signalling and are routed to the
+//    interrupts PS7IRQ_ID_DMAC0..7, events 8..15 are used to pace transfers
+//    to/from peripheral FIFOs.
+//
+//    PS peripherals (QSPI, SPI, UART) have no DMA request lines - peripheral
+//    request interfaces of PL330 are connected to PL only. So peripheral
+//    transfers are paced by software: the program waits for the pacing event
+//    (DMAWFE) before each FIFO-sized chunk, peripheral driver signals the event
+//    from its FIFO level interrupt by kick() and re-arms the interrupt from
+//    'pace' hook called when the chunk is moved.
+//
+//    Memory buffers are cleaned/invalidated by the driver, destination buffers
+//    should be cache line aligned.
+//
+//    Usage example:
+//
+//        Dmac dma;
+//
+//        void dma_isr()       { dma.isr();       }
+//        void dma_abort_isr() { dma.abort_isr(); }
+//        ...
+//        const uint32_t DMAC_IRQ[] = { PS7IRQ_ID_DMAC0, PS7IRQ_ID_DMAC1,     // one line
+//                                      PS7IRQ_ID_DMAC2, PS7IRQ_ID_DMAC3,     // per channel
+//                                      PS7IRQ_ID_DMAC4, PS7IRQ_ID_DMAC5,
+//                                      PS7IRQ_ID_DMAC6, PS7IRQ_ID_DMAC7 };
+//        dma.init();
+//        for(uint32_t i = 0; i < Dmac::CHANNELS; ++i)   // channels in use
+//        {
+//            ps7_register_isr(dma_isr, DMAC_IRQ[i]);
+//            gic_set_target(DMAC_IRQ[i], GIC_CPU0);
+//            gic_int_enable(DMAC_IRQ[i]);
+//        }
+//        ps7_register_isr(dma_abort_isr, PS7IRQ_ID_DMAC_ABORT);
+//        gic_set_target(PS7IRQ_ID_DMAC_ABORT, GIC_CPU0);
+//        gic_int_enable(PS7IRQ_ID_DMAC_ABORT);
+//        ...
+//        int ch = dma.alloc();
+//        dma.copy(ch, dst, src, size, done, 0);
+//
+class Dmac
+{
+public:
+    struct Regs
+    {
+        uint32_t DSR;                   //  0x000    ro    DMA Manager Status Register
+        uint32_t DPC;                   //  0x004    ro    DMA Program Counter Register
+        uint32_t RESERVED0[6];          //
+        uint32_t INTEN;                 //  0x020    rw    Interrupt Enable Register
+        uint32_t INT_EVENT_RIS;         //  0x024    ro    Event-Interrupt Raw Status Register
+        uint32_t INTMIS;                //  0x028    ro    Interrupt Status Register
+        uint32_t INTCLR;                //  0x02c    wo    Interrupt Clear Register
+        uint32_t FSRD;                  //  0x030    ro    Fault Status DMA Manager Register
+        uint32_t FSRC;                  //  0x034    ro    Fault Status DMA Channel Register
+        uint32_t FTRD;                  //  0x038    ro    Fault Type DMA Manager Register
+        uint32_t RESERVED1;             //
+        uint32_t FTR[8];                //  0x040    ro    Fault Type DMA Channel Registers
+        uint32_t RESERVED2[40];         //
+        struct
+        {
+            uint32_t CSR;               //  0x100    ro    Channel Status Register
+            uint32_t CPC;               //  0x104    ro    Channel Program Counter Register
+        }        CH_STS[8];
+        uint32_t RESERVED3[176];        //
+        struct
+        {
+            uint32_t SAR;               //  0x400    ro    Source Address Register
+            uint32_t DAR;               //  0x404    ro    Destination Address Register
+            uint32_t CCR;               //  0x408    ro    Channel Control Register
+            uint32_t LC0;               //  0x40c    ro    Loop Counter 0 Register
+            uint32_t LC1;               //  0x410    ro    Loop Counter 1 Register
+            uint32_t RESERVED[3];       //
+        }        CH_CTRL[8];
+        uint32_t RESERVED4[512];        //
+        uint32_t DBGSTATUS;             //  0xd00    ro    Debug Status Register
+        uint32_t DBGCMD;                //  0xd04    wo    Debug Command Register
+        uint32_t DBGINST0;              //  0xd08    wo    Debug Instruction-0 Register
+        uint32_t DBGINST1;              //  0xd0c    wo    Debug Instruction-1 Register
+    };
+
+    enum Event
+    {
+        evCHUNK,                        // peripheral chunk moved (internal)
+        evDONE,                         // transfer completed
+        evFAULT                         // channel fault, transfer aborted
+    };
+
+    typedef void (*callback_t)(void *ctx, const uint32_t ch, const Event ev);
+    typedef void (*pace_t)    (void *ctx);
+
+    struct Segment                      // scatter-gather list item
+    {
+        uintptr_t dst;
+        uintptr_t src;
+        uint32_t  size;                 // bytes
+    };
+
+    static const uintptr_t DMAC_S_ADDR  = 0xf8003000;  // secure APB interface
+    static const uint32_t  CHANNELS     = 8;
+    static const uint32_t  PROG_SIZE    = 512;         // bytes per channel
+
+public:
+    Dmac(const uintptr_t addr = DMAC_S_ADDR)
+        : regs( reinterpret_cast<Regs*>(addr) )
+        , allocated(0)
+    {
+    }
+
+    void init();
+
+    int  alloc();
+    void free(const uint32_t ch) { allocated &= ~(1ul << ch); }
+    bool busy(const uint32_t ch) const { return chan[ch].busy; }
+
+    bool copy   (const uint32_t ch, void *dst, const void *src, const uint32_t size, callback_t cb, void *ctx);
+    bool copy_sg(const uint32_t ch, const Segment *sg, const uint32_t count, callback_t cb, void *ctx);
+
+    bool to_fifo  (const uint32_t   ch,
+                   volatile void   *fifo,
+                   const void      *src,
+                   const uint32_t   size,
+                   const uint32_t   chunk,
+                   pace_t           pace,
+                   void            *pctx,
+                   callback_t       cb,
+                   void            *ctx);
+
+    bool from_fifo(const uint32_t   ch,
+                   void            *dst,
+                   volatile void   *fifo,
+                   const uint32_t   size,
+                   const uint32_t   chunk,
+                   pace_t           pace,
+                   void            *pctx,
+                   callback_t       cb,
+                   void            *ctx);
+
+    void kick (const uint32_t ch) { exec( ((pace_event(ch) << 3) << 24) + (opSEV << 16), 0 ); }
+    void abort(const uint32_t ch);
+
+    void isr();
+    void abort_isr();
+
+private:
+    enum OpCode : uint8_t
+    {
+        opEND      = 0x00,
+        opKILL     = 0x01,
+        opLD       = 0x04,
+        opST       = 0x08,
+        opWMB      = 0x13,
+        opLP       = 0x20,
+        opSEV      = 0x34,
+        opWFE      = 0x36,
+        opLPEND    = 0x38,
+        opGO       = 0xa0,
+        opMOV      = 0xbc
+    };
+
+    enum MovReg : uint8_t
+    {
+        rSAR = 0,
+        rCCR = 1,
+        rDAR = 2
+    };
+
+    //--------------------------------------------------------------------------
+    //
+    //    Microcode program builder
+    //
+    class Program
+    {
+    public:
+        Program(uint8_t *p) : buf(p), pos(0) { }
+
+        void     mov  (const MovReg r, const uint32_t val);
+        void     lp   (const uint32_t lc, const uint32_t iter);
+        void     lpend(const uint32_t lc, const uint32_t start);
+        void     op   (const OpCode code)                    { emit(code); }
+        void     op   (const OpCode code, const uint8_t arg) { emit(code); emit(arg); }
+        uint32_t size () const { return pos; }
+        bool     fits (const uint32_t n) const { return pos + n <= PROG_SIZE; }
+
+        template<typename F> void loop(uint32_t count, F body);
+
+    private:
+        void emit(const uint8_t b) { if(pos < PROG_SIZE) buf[pos] = b; ++pos; }
+
+        uint8_t  *buf;
+        uint32_t  pos;
+    };
+
+    struct Channel
+    {
+        volatile bool     busy;
+        callback_t        cb;
+        void             *ctx;
+        pace_t            pace;
+        void             *pctx;
+        uint32_t          chunks;       // peripheral chunks left
+        const Segment    *sg;           // destination ranges to invalidate
+        uint32_t          sg_count;
+        Segment           seg;          // single segment storage for copy()/from_fifo()
+    };
+
+    static uint32_t pace_event(const uint32_t ch) { return ch + CHANNELS; }
+    static uint32_t ccr(const uint32_t src_inc, const uint32_t dst_inc, const uint32_t size, const uint32_t len);
+
+    void gen_copy  (Program &prg, const Segment &seg);
+    bool gen_fifo  (const uint32_t ch, const Segment &seg, const bool tx, const uint32_t chunk);
+    bool start     (const uint32_t ch, const Program &prg);
+    void exec      (const uint32_t inst0, const uint32_t inst1);
+    void setup     (const uint32_t ch, callback_t cb, void *ctx, pace_t pace, void *pctx);
+    void finish    (const uint32_t ch, const Event ev);
+
+private:
+    volatile Regs  *regs;
+    uint32_t        allocated;
+    Channel         chan[CHANNELS];
+    uint8_t         prog[CHANNELS][PROG_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+//------------------------------------------------------------------------------
+
+#endif  // PS7DMAC_H
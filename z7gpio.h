@@ -41,12 +41,36 @@
 namespace gpio
 {
 
+//------------------------------------------------------------------------------
+//
+//    Pin number (same as in z7int.h GPIO support) is:
+//
+//         0..31  for bank0
+//        32..53  for bank1
+//        64..95  for bank2
+//        96..127 for bank3
+//
+//    Each bank has two MASK_DATA registers (LSW/MSW), so half-word register
+//    index is simply id/16: upper half-word is mask (1: keep the pin), lower
+//    half-word is data
+//
+const uint32_t BANKS = 4;
+
+constexpr bool valid_pin(const uint32_t id) { return id < BANKS*32 && !(id >= 54 && id < 64); }
+
+constexpr uint32_t bank_of(const uint32_t id) { return id/32; }
+constexpr uint32_t bit_of (const uint32_t id) { return id%32; }
+
+constexpr uintptr_t mask_data_reg(const uint32_t bank, const uint32_t msw) { return GPIO_MASK_DATA_0_LSW_REG + (bank*2 + msw)*4; }
+constexpr uintptr_t data_reg     (const uint32_t bank) { return GPIO_DATA_0_REG    + bank*4; }
+constexpr uintptr_t data_ro_reg  (const uint32_t bank) { return GPIO_DATA_RO_0_REG + bank*4; }
+
 //------------------------------------------------------------------------------
 template<typename T>
 constexpr void pin_on(const T id)
 {
-    auto     reg        = GPIO_MASK_DATA_0_LSW_REG + id/16;
-    uint32_t num        = id%16;
+    auto     reg        = mask_data_reg(bank_of(id), bit_of(id)/16);
+    uint32_t num        = bit_of(id)%16;
     uint32_t clear_mask = ~(1ul << num) << 16;
     uint32_t set_mask   =   1ul << num;
     
@@ -56,8 +80,8 @@ constexpr void pin_on(const T id)
 template<typename T>
 constexpr void pin_off(const T id)
 {
-    auto     reg        = GPIO_MASK_DATA_0_LSW_REG + id/16;
-    uint32_t num        = id%16;
+    auto     reg        = mask_data_reg(bank_of(id), bit_of(id)/16);
+    uint32_t num        = bit_of(id)%16;
     uint32_t clear_mask = ~(1ul << num) << 16;
 
     wpa(reg, clear_mask);
@@ -65,10 +89,156 @@ constexpr void pin_off(const T id)
 //------------------------------------------------------------------------------
 inline bool pin_is_set(const uint32_t id)
 {
-    return rpa(GPIO_DATA_0_REG) & (1ul << id);
+    return rpa(data_ro_reg(bank_of(id))) & (1ul << bit_of(id));
 }
 //------------------------------------------------------------------------------
+inline uint32_t read_bank(const uint32_t bank)
+{
+    return rpa(data_ro_reg(bank));
+}
+//------------------------------------------------------------------------------
+//
+//    Compile-time pin set
+//
+//    Pins are grouped by bank and half-word at compile time, so on()/off()/
+//    write() emit one MASK_DATA write per touched half-word, or one DATA write
+//    for a fully covered bank. write() and read() map bit i of the value to
+//    the i-th pin of the set; pins going in ascending order within one bank
+//    (typical parallel bus) are moved by a single shift.
+//
+//    Usage example:
+//
+//        typedef gpio::PinSet<64, 65, 66, 67, 68, 69, 70, 71> DataBus;
+//        typedef gpio::PinSet<72, 73>                         Strobes;
+//
+//        DataBus::write(byte);
+//        Strobes::on();
+//
+template<uint32_t... Pins>
+struct PinSet
+{
+    static_assert(sizeof...(Pins) > 0 && sizeof...(Pins) <= 32, "PinSet must have 1..32 pins");
+
+    static const uint32_t COUNT = sizeof...(Pins);
+
+    static constexpr bool valid()
+    {
+        for(uint32_t i = 0; i < COUNT; ++i)
+        {
+            if(!valid_pin(pin(i)))
+                return false;
+            for(uint32_t j = 0; j < i; ++j)
+            {
+                if(pin(j) == pin(i))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    static constexpr uint32_t pin(const uint32_t i)
+    {
+        const uint32_t PINS[] = { Pins... };
+        return PINS[i];
+    }
+
+    static_assert(valid(), "PinSet pins must be z7int.h pin numbers (bank1 < 54, < 128) without duplicates");
+
+    static constexpr uint32_t mask(const uint32_t bank)
+    {
+        uint32_t m = 0;
+        for(uint32_t i = 0; i < COUNT; ++i)
+        {
+            if(bank_of(pin(i)) == bank)
+            {
+                m |= 1ul << bit_of(pin(i));
+            }
+        }
+        return m;
+    }
+
+    //  all pins in one bank in ascending order without gaps
+    static constexpr bool contiguous()
+    {
+        for(uint32_t i = 1; i < COUNT; ++i)
+        {
+            if(bank_of(pin(i)) != bank_of(pin(0)) || bit_of(pin(i)) != bit_of(pin(0)) + i)
+                return false;
+        }
+        return true;
+    }
+
+    INLINE static void on()  { for(uint32_t b = 0; b < BANKS; ++b) out(b, mask(b)); }
+    INLINE static void off() { for(uint32_t b = 0; b < BANKS; ++b) out(b, 0);       }
 
+    INLINE static void write(const uint32_t value)
+    {
+        if(contiguous())
+        {
+            out(bank_of(pin(0)), value << bit_of(pin(0)));
+            return;
+        }
+
+        uint32_t v[BANKS] = { 0, 0, 0, 0 };
+        for(uint32_t i = 0; i < COUNT; ++i)
+        {
+            if(value & (1ul << i))
+            {
+                v[bank_of(pin(i))] |= 1ul << bit_of(pin(i));
+            }
+        }
+        for(uint32_t b = 0; b < BANKS; ++b)
+        {
+            out(b, v[b]);
+        }
+    }
+
+    //  one DATA_RO read per touched bank
+    INLINE static uint32_t read()
+    {
+        const uint32_t COUNT_MASK = COUNT < 32 ? (1ul << COUNT) - 1 : 0xffffffff;
+
+        if(contiguous())
+            return (read_bank(bank_of(pin(0))) >> bit_of(pin(0))) & COUNT_MASK;
+
+        uint32_t bank[BANKS];
+        for(uint32_t b = 0; b < BANKS; ++b)
+        {
+            bank[b] = mask(b) ? read_bank(b) : 0;
+        }
+
+        uint32_t value = 0;
+        for(uint32_t i = 0; i < COUNT; ++i)
+        {
+            if(bank[bank_of(pin(i))] & (1ul << bit_of(pin(i))))
+            {
+                value |= 1ul << i;
+            }
+        }
+        return value;
+    }
+
+private:
+    INLINE static void out(const uint32_t bank, const uint32_t value)
+    {
+        const uint32_t M = mask(bank);
+
+        if(M == 0xffffffff)
+        {
+            wpa(data_reg(bank), value);
+            return;
+        }
+        if(M & 0xffff)
+        {
+            wpa(mask_data_reg(bank, 0), ((~M & 0xffff) << 16) | (value & M & 0xffff));
+        }
+        if(M >> 16)
+        {
+            wpa(mask_data_reg(bank, 1), (~M & 0xffff0000) | ((value & M) >> 16));
+        }
+    }
+};
+//------------------------------------------------------------------------------
 
 }
 
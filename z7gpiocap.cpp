@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi GPIO Edge Capture Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <z7gpio.h>
+#include <z7gpiocap.h>
+
+//------------------------------------------------------------------------------
+EdgeCapture *EdgeCapture::channels[GPIO_PIN_COUNT];
+uint64_t     EdgeCapture::stamp;
+uint32_t     EdgeCapture::clock = 1;
+
+//------------------------------------------------------------------------------
+EdgeCapture::EdgeCapture()
+    : pinnum(GPIO_PIN_COUNT)
+    , any_edge(true)
+    , lost_count(0)
+    , prev(0)
+    , last_rise(0)
+{
+}
+//------------------------------------------------------------------------------
+void EdgeCapture::start(const uint32_t pin, const bool any)
+{
+    stop();
+
+    pinnum     = pin;
+    any_edge   = any;
+    lost_count = 0;
+    prev       = 0;
+    last_rise  = 0;
+    ring.clear();
+
+    channels[pin] = this;
+    gpio_register_isr(handler, pin);
+    gpio_int_cfg(pin, GPIO_INT_TYPE_EDGE, GPIO_INT_POL_HIGH_RISE, any);
+    gpio_clr_int_sts(pin);
+    gpio_int_en(pin);
+}
+//------------------------------------------------------------------------------
+void EdgeCapture::stop()
+{
+    if(pinnum >= GPIO_PIN_COUNT)
+        return;
+
+    gpio_int_dis(pinnum);
+    gpio_register_isr(0, pinnum);
+    channels[pinnum] = 0;
+    pinnum           = GPIO_PIN_COUNT;
+}
+//------------------------------------------------------------------------------
+//
+//    Consumes all samples in the ring and returns averages over them.
+//
+//    Period is measured between rising edges, high time between a rising
+//    edge and the falling edge that immediately follows it (any-edge mode
+//    only). Edge state is kept between calls, so the measurement spans the
+//    call boundaries. Returns false if no period has been measured.
+//
+bool EdgeCapture::stats(Stats &s)
+{
+    uint64_t period_sum = 0;
+    uint64_t high_sum   = 0;
+    uint32_t highs      = 0;
+
+    s.edges   = 0;
+    s.periods = 0;
+
+    uint64_t sample;
+    while(ring.pop(sample))
+    {
+        const uint64_t t = sample & TICK_MASK;
+
+        ++s.edges;
+        if(sample & LEVEL_BIT)
+        {
+            if(last_rise)
+            {
+                period_sum += t - last_rise;
+                ++s.periods;
+            }
+            last_rise = t;
+        }
+        else if(prev & LEVEL_BIT)
+        {
+            high_sum += t - (prev & TICK_MASK);
+            ++highs;
+        }
+        prev = sample;
+    }
+
+    if(!s.periods)
+    {
+        s.period = 0;
+        s.high   = 0;
+        s.freq   = 0;
+        s.duty   = 0;
+        return false;
+    }
+
+    s.period = period_sum/s.periods;
+    s.high   = highs ? high_sum/highs : 0;
+    s.freq   = s.period ? clock*1000ull/s.period : 0;
+    s.duty   = s.period ? s.high*10000/s.period  : 0;
+
+    return true;
+}
+//------------------------------------------------------------------------------
+void EdgeCapture::isr()
+{
+    stamp = GlobalTimer::read();
+    gpio_isr();
+}
+//------------------------------------------------------------------------------
+void EdgeCapture::handler(uint32_t pin)
+{
+    EdgeCapture *c = channels[pin];
+
+    const bool     LEVEL  = c->any_edge ? gpio::pin_is_set(pin) : true;
+    const uint64_t SAMPLE = (stamp & TICK_MASK) | (LEVEL ? LEVEL_BIT : 0);
+
+    if(!c->ring.push(SAMPLE))
+    {
+        c->lost_count = c->lost_count + 1;
+    }
+}
+//------------------------------------------------------------------------------
+
@@ -0,0 +1,127 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi GPIO Edge Capture Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7GPIOCAP_H
+#define PS7GPIOCAP_H
+
+#include "z7int.h"
+#include "z7gtmr.h"
+#include "z7ring.h"
+
+//------------------------------------------------------------------------------
+//
+//    GPIO edge capture timestamped by global timer
+//
+//    Notes:
+//    ~~~~~
+//    EdgeCapture::isr() is the first-level handler of PS7IRQ_ID_GPIO (it is
+//    registered instead of gpio_isr()). It latches the global timer once on
+//    entry and then runs gpio_isr(), so every edge serviced in this interrupt
+//    gets the same stamp, free of the demultiplexer and handler latency. Pins
+//    without capture channel keep their own gpio_register_isr() handlers.
+//
+//    Each channel owns an SPSC ring of 64-bit samples: timer ticks in bits
+//    62:0 and pin level after the edge in bit 63 (LEVEL_BIT). The ring is
+//    filled from the ISR and read by pop() or stats() from the application;
+//    a sample that does not fit is counted by lost().
+//
+//    In any-edge mode the level is sampled from DATA_RO, so both rising and
+//    falling edges are told apart and duty cycle is measured; in rising-edge
+//    mode every sample is marked high. GPIO latches one event per pin until
+//    serviced, so edges closer than the ISR response merge into one sample.
+//
+//    Usage example:
+//
+//        EdgeCapture tacho;
+//
+//        GlobalTimer::start();
+//        EdgeCapture::set_clock(CPU_3x2x_FREQ);
+//        ps7_register_isr(EdgeCapture::isr, PS7IRQ_ID_GPIO);
+//        tacho.start(50);
+//        ...
+//        EdgeCapture::Stats s;
+//        if(tacho.stats(s)) { ... s.freq ... s.duty ... }
+//
+class EdgeCapture
+{
+public:
+    static const uint32_t RING_SIZE = 256;
+    static const uint64_t LEVEL_BIT = 1ull << 63;
+    static const uint64_t TICK_MASK = LEVEL_BIT - 1;
+
+    struct Stats
+    {
+        uint32_t edges;     // samples processed
+        uint32_t periods;   // periods measured
+        uint64_t period;    // average period, timer ticks
+        uint64_t high;      // average high time, timer ticks
+        uint32_t freq;      // mHz
+        uint32_t duty;      // 0.01 %
+    };
+
+    EdgeCapture();
+
+    void     start(const uint32_t pin, const bool any = true);
+    void     stop();
+
+    bool     pop(uint64_t &sample) { return ring.pop(sample); }
+    uint32_t count() const         { return ring.count();    }
+    uint32_t lost()  const         { return lost_count;      }
+
+    bool     stats(Stats &s);
+
+    static void     set_clock(const uint32_t hz) { clock = hz; }
+    static uint64_t ticks_to_ns(const uint64_t t) { return t/clock*1000000000ull + t%clock*1000000000ull/clock; }
+
+    static void isr();
+
+private:
+    static void handler(uint32_t pin);
+
+private:
+    RingBuffer<uint64_t, RING_SIZE> ring;
+
+    uint32_t          pinnum;
+    bool              any_edge;
+    volatile uint32_t lost_count;
+
+    uint64_t          prev;         // last processed sample, 0: none
+    uint64_t          last_rise;    // 0: none
+
+    static EdgeCapture *channels[GPIO_PIN_COUNT];
+    static uint64_t     stamp;
+    static uint32_t     clock;
+};
+//------------------------------------------------------------------------------
+
+#endif // PS7GPIOCAP_H
+//------------------------------------------------------------------------------
+
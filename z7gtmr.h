@@ -0,0 +1,76 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi CPU Global Timer Stuff Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7GTMR_H
+#define PS7GTMR_H
+
+#include <stdint.h>
+#include <ps7mmrs.h>
+#include <z7common.h>
+
+//------------------------------------------------------------------------------
+//
+//    64-bit global timer shared by both CPUs, clocked by CPU_3x2x
+//
+//    Notes:
+//    ~~~~~
+//    The counter is read as two 32-bit halves, so read() takes high, low and
+//    high again and retries if the high word changed, i.e. the low word
+//    wrapped between the accesses.
+//
+struct GlobalTimer
+{
+    static void start(const uint32_t prescaler = 0)
+    {
+        wpa(GTMR_CTLR_REG, (prescaler << GTMR_CTLR_PRESCALER_BPOS) | GTMR_CTLR_TIMER_ENABLE_MASK);
+    }
+
+    static void stop() { cbpa(GTMR_CTLR_REG, GTMR_CTLR_TIMER_ENABLE_MASK); }
+
+    INLINE static uint64_t read()
+    {
+        uint32_t hi;
+        uint32_t lo;
+        do
+        {
+            hi = rpa(GTMR_COUNTER_HI_REG);
+            lo = rpa(GTMR_COUNTER_LO_REG);
+        }
+        while(hi != rpa(GTMR_COUNTER_HI_REG));
+
+        return (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+};
+//------------------------------------------------------------------------------
+
+#endif // PS7GTMR_H
+//------------------------------------------------------------------------------
+
@@ -39,4 +39,42 @@ void ps7_register_isr(isr_ptr_t ptr, uint32_t id)
     ps7_handlers[id] = ptr;
 }
 //------------------------------------------------------------------------------
+gpio_isr_ptr_t gpio_handlers[GPIO_PIN_COUNT];
+//------------------------------------------------------------------------------
+void gpio_register_isr(gpio_isr_ptr_t ptr, uint32_t pinnum)
+{
+    gpio_handlers[pinnum] = ptr;
+}
+//------------------------------------------------------------------------------
+void gpio_isr()
+{
+    for(uint32_t bank = 0; bank < GPIO_BANKS; ++bank)
+    {
+        const uint32_t OFFSET  = bank*GPIO_BANK_STEP;
+        uint32_t       pending = rpa(GPIO_INT_STAT_0_REG + OFFSET) & ~rpa(GPIO_INT_MASK_0_REG + OFFSET);
+
+        if(!pending)
+            continue;
 
+        wpa(GPIO_INT_STAT_0_REG + OFFSET, pending);
+
+        while(pending)
+        {
+            const uint32_t bit = 31 - __clz(pending);
+            const uint32_t pin = bank*32 + bit;
+
+            pending &= ~(1ul << bit);
+
+            gpio_isr_ptr_t h = gpio_handlers[pin];
+            if(h)
+            {
+                h(pin);
+            }
+            else
+            {
+                wpa(GPIO_INT_DIS_0_REG + OFFSET, 1ul << bit);
+            }
+        }
+    }
+}
+//------------------------------------------------------------------------------
@@ -335,11 +335,23 @@ extern isr_ptr_t ps7_handlers[PS7_MAX_IRQ_ID];
 //         0..31  for bank0
 //        32..53  for bank1
 //        64..95  for bank2
-//        96..128 for bank3
+//        96..127 for bank3
 //
+const uint32_t GPIO_BANKS     = 4;
+const uint32_t GPIO_PIN_COUNT = GPIO_BANKS*32;
+const uint32_t GPIO_BANK_STEP = 0x40;
+
 INLINE void gpio_int_en(const uint32_t pinnum)
 {
-    const uint32_t  REG_ADDR = GPIO_INT_EN_0_REG + pinnum/32*0x40;
+    const uint32_t  REG_ADDR = GPIO_INT_EN_0_REG + pinnum/32*GPIO_BANK_STEP;
+    const uint32_t  BIT_MASK = 0x1ul << pinnum%32;
+
+    wpa(REG_ADDR, BIT_MASK);
+}
+//------------------------------------------------------------------------------
+INLINE void gpio_int_dis(const uint32_t pinnum)
+{
+    const uint32_t  REG_ADDR = GPIO_INT_DIS_0_REG + pinnum/32*GPIO_BANK_STEP;
     const uint32_t  BIT_MASK = 0x1ul << pinnum%32;
 
     wpa(REG_ADDR, BIT_MASK);
@@ -351,23 +363,95 @@ enum GpioIntPol : uint32_t
     GPIO_INT_POL_HIGH_RISE = 1
 };
 
-INLINE void gpio_int_pol(const uint32_t pinnum, const GpioIntPol)
+INLINE void gpio_int_pol(const uint32_t pinnum, const GpioIntPol pol)
+{
+    const uint32_t  REG_ADDR = GPIO_INT_POLARITY_0_REG + pinnum/32*GPIO_BANK_STEP;
+    const uint32_t  BIT_MASK = 0x1ul << pinnum%32;
+
+    if(pol == GPIO_INT_POL_HIGH_RISE)
+        sbpa(REG_ADDR, BIT_MASK);
+    else
+        cbpa(REG_ADDR, BIT_MASK);
+}
+//------------------------------------------------------------------------------
+enum GpioIntType : uint32_t
+{
+    GPIO_INT_TYPE_LEVEL = 0,
+    GPIO_INT_TYPE_EDGE  = 1
+};
+
+INLINE void gpio_int_type(const uint32_t pinnum, const GpioIntType type)
 {
-    const uint32_t  REG_ADDR = GPIO_INT_POLARITY_0_REG + pinnum/32*0x40;
+    const uint32_t  REG_ADDR = GPIO_INT_TYPE_0_REG + pinnum/32*GPIO_BANK_STEP;
     const uint32_t  BIT_MASK = 0x1ul << pinnum%32;
 
-    sbpa(REG_ADDR, BIT_MASK);
+    if(type == GPIO_INT_TYPE_EDGE)
+        sbpa(REG_ADDR, BIT_MASK);
+    else
+        cbpa(REG_ADDR, BIT_MASK);
+}
+//------------------------------------------------------------------------------
+//
+//    Any edge: both rising and falling edges trigger the interrupt, polarity
+//    is ignored. Takes effect for edge type only
+//
+INLINE void gpio_int_any(const uint32_t pinnum, const bool any)
+{
+    const uint32_t  REG_ADDR = GPIO_INT_ANY_0_REG + pinnum/32*GPIO_BANK_STEP;
+    const uint32_t  BIT_MASK = 0x1ul << pinnum%32;
+
+    if(any)
+        sbpa(REG_ADDR, BIT_MASK);
+    else
+        cbpa(REG_ADDR, BIT_MASK);
+}
+//------------------------------------------------------------------------------
+INLINE void gpio_int_cfg(const uint32_t    pinnum,
+                         const GpioIntType type,
+                         const GpioIntPol  pol,
+                         const bool        any = false)
+{
+    gpio_int_dis(pinnum);
+    gpio_int_type(pinnum, type);
+    gpio_int_pol(pinnum, pol);
+    gpio_int_any(pinnum, any);
 }
 //------------------------------------------------------------------------------
 //
 //
 INLINE void gpio_clr_int_sts(const uint32_t pinnum)
 {
-    const uint32_t  REG_ADDR = GPIO_INT_STAT_0_REG + pinnum/32*0x40;
+    const uint32_t  REG_ADDR = GPIO_INT_STAT_0_REG + pinnum/32*GPIO_BANK_STEP;
     const uint32_t  BIT_MASK = 0x1ul << pinnum%32;
 
     wpa(REG_ADDR, BIT_MASK);  // reset interrupt status
 }
+//------------------------------------------------------------------------------
+//
+//    GPIO interrupt demultiplexer
+//
+//    All GPIO pins share the single PS7IRQ_ID_GPIO line. gpio_isr() reads
+//    INT_STAT & ~INT_MASK of each bank, clears the pending bits with one write
+//    and calls the handler registered for every set bit (highest first).
+//    Status is cleared before the handlers run, so an edge arriving during a
+//    handler is not lost. A pending pin without a handler is disabled.
+//
+//    Usage example:
+//
+//        void button_isr(uint32_t pin) { ... }
+//
+//        gpio_register_isr(button_isr, 50);
+//        gpio_int_cfg(50, GPIO_INT_TYPE_EDGE, GPIO_INT_POL_LOW_FALL);
+//        gpio_int_en(50);
+//        ps7_register_isr(gpio_isr, PS7IRQ_ID_GPIO);
+//
+typedef void (*gpio_isr_ptr_t)(uint32_t pinnum);
+
+void gpio_register_isr(gpio_isr_ptr_t ptr, uint32_t pinnum);
+void gpio_isr();
+
+extern gpio_isr_ptr_t gpio_handlers[GPIO_PIN_COUNT];
+
 //------------------------------------------------------------------------------
 
 #endif  // PS7INT_H
@@ -0,0 +1,494 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi Flash Key-Value Store Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <string.h>
+#include <z7crc32.h>
+#include <z7kvstore.h>
+
+//------------------------------------------------------------------------------
+static const uint32_t KVS_MAGIC  = 0x3153564b;    // "KVS1"
+static const uint32_t COPY_CHUNK = 256;
+
+//------------------------------------------------------------------------------
+KvStore::KvStore(Qspi &q, const uint32_t b, const uint32_t sectors, Entry *idx, const uint32_t idx_size)
+    : qspi(q)
+    , base(b)
+    , sector_count(sectors < MAX_SECTORS ? sectors : MAX_SECTORS)
+    , sector_size(4096)
+    , erase_cmd(Qspi::cmdEB4K)
+    , index(idx)
+    , index_size(idx_size)
+    , entries(0)
+    , seq(0)
+    , active(NONE)
+    , wr_pos(0)
+    , erasing(NONE)
+{
+}
+//------------------------------------------------------------------------------
+//
+//    Returns false if the index is too small for the stored keys or the
+//    store can not open active sector
+//
+bool KvStore::mount()
+{
+    bool res = true;
+
+    geometry();
+    entries     = 0;
+    seq         = 0;
+    active      = NONE;
+    erasing     = NONE;
+
+    for(uint32_t i = 0; i < sector_count; ++i)
+    {
+        SectorHdr hdr;
+        qspi.read(sector_addr(i), &hdr, sizeof(hdr));
+
+        if(hdr.magic == KVS_MAGIC && hdr.seq != SECTOR_FREE && hdr.seq != SECTOR_DIRTY)
+        {
+            sectors[i] = hdr.seq;
+            if(hdr.seq > seq)
+            {
+                seq = hdr.seq;
+            }
+        }
+        else
+        {
+            sectors[i] = qspi.is_blank(sector_addr(i), sector_size) ? SECTOR_FREE : SECTOR_DIRTY;
+        }
+    }
+
+    //  replay sectors from the oldest to the newest one
+    for(uint32_t last = 0; ; )
+    {
+        uint32_t next = NONE;
+        for(uint32_t i = 0; i < sector_count; ++i)
+        {
+            const uint32_t S = sectors[i];
+            if(S != SECTOR_FREE && S != SECTOR_DIRTY && S > last && (next == NONE || S < sectors[next]))
+            {
+                next = i;
+            }
+        }
+        if(next == NONE)
+            break;
+
+        active = next;
+        wr_pos = scan(next, res);
+        last   = sectors[next];
+    }
+
+    for(uint32_t i = 0; i < sector_count; ++i)
+    {
+        if(sectors[i] == SECTOR_DIRTY)
+        {
+            qspi.erase(sector_addr(i), erase_cmd);
+            sectors[i] = SECTOR_FREE;
+        }
+    }
+
+    if(active == NONE && !open_sector(false))
+        return false;
+
+    return res;
+}
+//------------------------------------------------------------------------------
+void KvStore::format()
+{
+    geometry();
+    qspi.erase_range(base, sector_count*sector_size);
+    mount();
+}
+//------------------------------------------------------------------------------
+//
+//    'len' is the destination buffer size on input and the value length on
+//    output, the value is truncated if the buffer is too small
+//
+bool KvStore::get(const uint32_t key, void *dst, uint32_t &len) const
+{
+    const Entry *e = find(key);
+    if(!e)
+        return false;
+
+    const uint32_t COUNT = len < e->len ? len : e->len;
+    if(COUNT)
+    {
+        qspi.read(e->addr + REC_HDR_SIZE, dst, COUNT);
+    }
+    len = e->len;
+
+    return true;
+}
+//------------------------------------------------------------------------------
+bool KvStore::set(const uint32_t key, const void *data, const uint32_t len)
+{
+    if(key == INVALID_KEY || len > max_len())
+        return false;
+
+    Entry *e = find(key);
+    if(!e && entries == index_size)
+        return false;
+
+    RecHdr hdr = { key, static_cast<uint16_t>(len), 0, 0 };
+    hdr.crc = crc32(data, len, crc32(&hdr, REC_HDR_SIZE - sizeof(hdr.crc)));
+
+    const uint32_t addr = put(hdr, data);
+    if(!addr)
+        return false;
+
+    e = find(key);                           // compaction could move index entries
+    if(e)
+    {
+        e->addr = addr;
+        e->len  = len;
+        return true;
+    }
+
+    return insert(key, addr, len);
+}
+//------------------------------------------------------------------------------
+bool KvStore::remove(const uint32_t key)
+{
+    if(!find(key))
+        return false;
+
+    RecHdr hdr = { key, 0, recTOMBSTONE, 0 };
+    hdr.crc = crc32(&hdr, REC_HDR_SIZE - sizeof(hdr.crc));
+
+    if(!put(hdr, 0))
+        return false;
+
+    drop(find(key));
+    return true;
+}
+//------------------------------------------------------------------------------
+//
+//    Returns true if some work was done
+//
+bool KvStore::compact_step()
+{
+    if(erasing != NONE)
+    {
+        if(qspi.busy())
+            return true;
+
+        complete_erase();
+        return true;
+    }
+
+    for(uint32_t i = 0; i < sector_count; ++i)
+    {
+        if(sectors[i] == SECTOR_DIRTY)      // failed sector open
+        {
+            erasing = i;
+            qspi.erase_start(sector_addr(i), erase_cmd);
+            return true;
+        }
+    }
+
+    if(free_sectors() > COMPACT_THRESHOLD)
+        return false;
+
+    uint32_t victim = NONE;
+    for(uint32_t i = 0; i < sector_count; ++i)
+    {
+        const uint32_t S = sectors[i];
+        if(i != active && S != SECTOR_FREE && S != SECTOR_DIRTY && (victim == NONE || S < sectors[victim]))
+        {
+            victim = i;
+        }
+    }
+    if(victim == NONE)
+        return false;
+
+    const uint32_t START = sector_addr(victim);
+    const uint32_t END   = START + sector_size;
+
+    for(uint32_t i = 0; i < entries; ++i)
+    {
+        Entry &e = index[i];
+        if(e.addr < START || e.addr >= END)
+            continue;
+
+        RecHdr hdr;
+        qspi.read(e.addr, &hdr, REC_HDR_SIZE);
+
+        const uint32_t addr = append(hdr, e.addr + REC_HDR_SIZE, 0);
+        if(!addr)
+            return false;                   // no space, the victim is kept intact
+
+        e.addr = addr;
+    }
+
+    //  tombstones and stale records are dropped together with the sector
+    sectors[victim] = SECTOR_DIRTY;
+    erasing         = victim;
+    qspi.erase_start(START, erase_cmd);
+
+    return true;
+}
+//------------------------------------------------------------------------------
+uint32_t KvStore::free_sectors() const
+{
+    uint32_t n = 0;
+    for(uint32_t i = 0; i < sector_count; ++i)
+    {
+        if(sectors[i] == SECTOR_FREE)
+        {
+            ++n;
+        }
+    }
+    return n;
+}
+//------------------------------------------------------------------------------
+KvStore::Entry *KvStore::find(const uint32_t key) const
+{
+    for(uint32_t i = 0; i < entries; ++i)
+    {
+        if(index[i].key == key)
+            return &index[i];
+    }
+    return 0;
+}
+//------------------------------------------------------------------------------
+bool KvStore::insert(const uint32_t key, const uint32_t addr, const uint32_t len)
+{
+    Entry *e = find(key);
+    if(!e)
+    {
+        if(entries == index_size)
+            return false;
+
+        e = &index[entries++];
+        e->key = key;
+    }
+    e->addr = addr;
+    e->len  = len;
+
+    return true;
+}
+//------------------------------------------------------------------------------
+void KvStore::drop(Entry *e)
+{
+    if(e)
+    {
+        *e = index[--entries];
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Replays records of the sector, returns offset of the free space; 'ok'
+//    is cleared on index overflow
+//
+uint32_t KvStore::scan(const uint32_t sector, bool &ok)
+{
+    const uint32_t ADDR = sector_addr(sector);
+    uint32_t       pos  = SECTOR_HDR_SIZE;
+
+    while(pos + REC_HDR_SIZE <= sector_size)
+    {
+        RecHdr hdr;
+        qspi.read(ADDR + pos, &hdr, REC_HDR_SIZE);
+
+        if(hdr.key == INVALID_KEY && hdr.len == 0xffff && hdr.flags == 0xffff)
+            break;                          // free space
+
+        const uint32_t SIZE = rec_size(hdr.len);
+        if(hdr.len > max_len() || pos + SIZE > sector_size)
+        {
+            pos = sector_size;              // damaged header, the rest is unusable
+            break;
+        }
+
+        if(check_crc(ADDR + pos, hdr))
+        {
+            if(hdr.flags & recTOMBSTONE)
+            {
+                drop(find(hdr.key));
+            }
+            else if(!insert(hdr.key, ADDR + pos, hdr.len))
+            {
+                ok = false;                 // index overflow
+            }
+        }
+        pos += SIZE;
+    }
+
+    return pos;
+}
+//------------------------------------------------------------------------------
+bool KvStore::check_crc(const uint32_t addr, const RecHdr &hdr)
+{
+    uint32_t buf[COPY_CHUNK/sizeof(uint32_t)];
+    uint32_t crc = crc32(&hdr, REC_HDR_SIZE - sizeof(hdr.crc));
+
+    for(uint32_t done = 0; done < hdr.len; )
+    {
+        const uint32_t LEN = hdr.len - done < COPY_CHUNK ? hdr.len - done : COPY_CHUNK;
+        qspi.read(addr + REC_HDR_SIZE + done, buf, LEN);
+        crc   = crc32(buf, LEN, crc);
+        done += LEN;
+    }
+
+    return crc == hdr.crc;
+}
+//------------------------------------------------------------------------------
+//
+//    Appends record, reclaims space if need. The number of compaction steps is
+//    limited: if live data do not fit, compaction just moves them around
+//
+uint32_t KvStore::put(const RecHdr &hdr, const void *data)
+{
+    uint32_t addr = append(hdr, NONE, data);
+
+    for(uint32_t n = 0; !addr && n < 2*sector_count && compact_step(); ++n)
+    {
+        addr = append(hdr, NONE, data);
+    }
+
+    return addr;
+}
+//------------------------------------------------------------------------------
+//
+//    Appends record to the active sector, the value is taken from RAM ('data')
+//    or copied from flash ('src') during compaction. Header is programmed
+//    first, so interrupted record is detected by CRC. Space of a failed record
+//    (0->1 transition on garbage) is skipped.
+//
+//    Returns the record address, 0 if there is no space.
+//
+uint32_t KvStore::append(const RecHdr &hdr, const uint32_t src, const void *data)
+{
+    const uint32_t SIZE    = rec_size(hdr.len);
+    const bool     RESERVE = src != NONE;   // compaction may use the reserved sector
+
+    for(;;)
+    {
+        if(active == NONE || wr_pos + SIZE > sector_size)
+        {
+            if(!open_sector(RESERVE))
+                return 0;
+        }
+
+        const uint32_t ADDR = sector_addr(active) + wr_pos;
+        wr_pos += SIZE;
+
+        if(!qspi.write(ADDR, &hdr, REC_HDR_SIZE))
+            continue;
+
+        if(hdr.len)
+        {
+            const bool OK = src != NONE ? copy_data(ADDR + REC_HDR_SIZE, src, hdr.len)
+                                        : qspi.write(ADDR + REC_HDR_SIZE, data, hdr.len);
+            if(!OK)
+                continue;
+        }
+
+        return ADDR;
+    }
+}
+//------------------------------------------------------------------------------
+bool KvStore::open_sector(const bool reserve)
+{
+    if(erasing != NONE)
+    {
+        qspi.wait();
+        complete_erase();
+    }
+
+    if(free_sectors() <= (reserve ? 0 : 1))
+        return false;
+
+    const uint32_t START = active == NONE ? 0 : active + 1;
+    for(uint32_t n = 0; n < sector_count; ++n)
+    {
+        const uint32_t i = (START + n) % sector_count;
+        if(sectors[i] != SECTOR_FREE)
+            continue;
+
+        const SectorHdr hdr = { KVS_MAGIC, ++seq };
+        if(!qspi.write(sector_addr(i), &hdr, SECTOR_HDR_SIZE))
+        {
+            sectors[i] = SECTOR_DIRTY;      // erased by compact_step()
+            continue;
+        }
+
+        sectors[i] = seq;
+        active     = i;
+        wr_pos     = SECTOR_HDR_SIZE;
+        return true;
+    }
+
+    return false;
+}
+//------------------------------------------------------------------------------
+bool KvStore::copy_data(const uint32_t dst, const uint32_t src, const uint32_t len)
+{
+    uint32_t buf[COPY_CHUNK/sizeof(uint32_t)];
+
+    for(uint32_t done = 0; done < len; )
+    {
+        const uint32_t LEN = len - done < COPY_CHUNK ? len - done : COPY_CHUNK;
+        qspi.read(src + done, buf, LEN);
+        if(!qspi.write(dst + done, buf, LEN))
+            return false;
+        done += LEN;
+    }
+
+    return true;
+}
+//------------------------------------------------------------------------------
+void KvStore::complete_erase()
+{
+    sectors[erasing] = SECTOR_FREE;
+    erasing          = NONE;
+}
+//------------------------------------------------------------------------------
+//
+//    Limited by sector size and by 16-bit record length field
+//
+uint32_t KvStore::max_len() const
+{
+    const uint32_t LEN = sector_size - SECTOR_HDR_SIZE - REC_HDR_SIZE;
+
+    return LEN < MAX_LEN ? LEN : MAX_LEN;
+}
+//------------------------------------------------------------------------------
+//
+//    Sector is the smallest erase block of the device
+//
+void KvStore::geometry()
+{
+    sector_size = qspi.min_erase_size();
+    erase_cmd   = qspi.min_erase_cmd();
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,166 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi Flash Key-Value Store Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7KVSTORE_H
+#define PS7KVSTORE_H
+
+#include "z7qspi.h"
+
+//------------------------------------------------------------------------------
+//
+//    Log-structured key-value store
+//
+//    Notes:
+//    ~~~~~
+//    The store occupies 'sectors' consecutive erase sectors (the smallest
+//    erase block of the device, Qspi::min_erase_size()) starting at 'base'.
+//    Each sector in use begins with a header holding sector sequence number,
+//    records are appended after it:
+//
+//        * header: key, value length, flags, CRC-32 of key/length/flags/value;
+//        * value, padded to word boundary.
+//
+//    set() and remove() append a record (value or tombstone) to the active
+//    sector, so an update costs one page program. When the active sector is
+//    full, the next free sector in ring order becomes active.
+//
+//    mount() scans the sectors in sequence number order and rebuilds the RAM
+//    index (user-supplied array): the record found later wins, records with
+//    bad CRC (interrupted program) are skipped, sectors with damaged header
+//    (interrupted erase) are erased.
+//
+//    compact_step() reclaims the oldest sector when the number of free sectors
+//    drops to COMPACT_THRESHOLD: live records are copied to the active sector
+//    and the sector erase is started in background (Qspi::erase_start), the
+//    next call completes it. Oldest-first reclaim moves the log around the
+//    ring, so erase cycles are spread evenly over all sectors. The function
+//    should be called periodically from the user's idle loop; set() calls it
+//    itself when it runs out of space. Power loss at any point leaves either
+//    the old or the new copy of a record valid.
+//
+//    One free sector is reserved for compaction, so the total size of live
+//    records must not exceed capacity of (sectors - 2) sectors.
+//
+class KvStore
+{
+public:
+    struct Entry
+    {
+        uint32_t key;
+        uint32_t addr;            // record address in flash
+        uint32_t len;             // value length, bytes
+    };
+
+    static const uint32_t MAX_SECTORS       = 64;
+    static const uint32_t COMPACT_THRESHOLD = 2;     // free sectors
+    static const uint32_t INVALID_KEY       = 0xffffffff;
+    static const uint32_t MAX_LEN           = 0xfffe;  // RecHdr::len, 0xffff: erased
+
+public:
+    KvStore(Qspi &q, const uint32_t base, const uint32_t sectors, Entry *idx, const uint32_t idx_size);
+
+    bool     mount();
+    void     format();
+
+    bool     get   (const uint32_t key, void *dst, uint32_t &len) const;
+    bool     set   (const uint32_t key, const void *data, const uint32_t len);
+    bool     remove(const uint32_t key);
+
+    bool     compact_step();
+
+    uint32_t count()        const { return entries; }
+    uint32_t max_len()      const;
+    uint32_t free_sectors() const;
+
+private:
+    struct SectorHdr
+    {
+        uint32_t magic;
+        uint32_t seq;
+    };
+
+    struct RecHdr
+    {
+        uint32_t key;
+        uint16_t len;
+        uint16_t flags;
+        uint32_t crc;
+    };
+
+    enum RecFlags : uint16_t
+    {
+        recTOMBSTONE = 1u << 0
+    };
+
+    static const uint32_t SECTOR_HDR_SIZE = sizeof(SectorHdr);
+    static const uint32_t REC_HDR_SIZE    = sizeof(RecHdr);
+    static const uint32_t NONE            = 0xffffffff;
+
+    //  sector states, other values are sequence numbers of sectors in use
+    static const uint32_t SECTOR_FREE     = 0;
+    static const uint32_t SECTOR_DIRTY    = 0xffffffff;
+
+    uint32_t sector_addr(const uint32_t i) const { return base + i*sector_size; }
+    static uint32_t rec_size(const uint32_t len) { return REC_HDR_SIZE + ((len + 3) & ~3ul); }
+
+    Entry   *find       (const uint32_t key) const;
+    bool     insert     (const uint32_t key, const uint32_t addr, const uint32_t len);
+    void     drop       (Entry *e);
+
+    uint32_t scan       (const uint32_t sector, bool &ok);
+    bool     check_crc  (const uint32_t addr, const RecHdr &hdr);
+    uint32_t put        (const RecHdr &hdr, const void *data);
+    uint32_t append     (const RecHdr &hdr, const uint32_t src, const void *data);
+    bool     open_sector(const bool reserve);
+    bool     copy_data  (const uint32_t dst, const uint32_t src, const uint32_t len);
+    void     complete_erase();
+    void     geometry();
+
+private:
+    Qspi             &qspi;
+    const uint32_t    base;
+    const uint32_t    sector_count;
+    uint32_t          sector_size;
+    Qspi::CommandCode erase_cmd;
+
+    Entry            *index;
+    const uint32_t    index_size;
+    uint32_t          entries;
+
+    uint32_t          sectors[MAX_SECTORS];    // state/sequence number
+    uint32_t          seq;                     // last sector sequence number
+    uint32_t          active;
+    uint32_t          wr_pos;                  // append offset in the active sector
+    uint32_t          erasing;                 // sector being erased in background
+};
+//------------------------------------------------------------------------------
+
+#endif  // PS7KVSTORE_H
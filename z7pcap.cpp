@@ -0,0 +1,163 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi PCAP Bitstream Loader Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <z7pcap.h>
+
+//------------------------------------------------------------------------------
+void Pcap::init()
+{
+    regs->UNLOCK   = UNLOCK_KEY;
+    regs->MCTRL   &= ~MCTRL_PCAP_LPBK;              // PCAP loopback off
+    regs->CTRL    |=  CTRL_PCAP_PR | CTRL_PCAP_MODE;
+    regs->CTRL    &= ~CTRL_PCAP_RATE_EN;
+    regs->INT_MASK =  0xffffffff;                   // polled, no interrupts
+    regs->INT_STS  =  0xffffffff;
+}
+//------------------------------------------------------------------------------
+//
+//    Chunk N + 1 is read from flash while chunk N is being sent to PCAP
+//
+bool Pcap::load(const uint32_t addr, const uint32_t size, const bool partial, uint32_t *crc)
+{
+    if(!chunk_size || !size || size % sizeof(uint32_t))
+        return false;
+
+    err = 0;
+    regs->INT_STS = 0xffffffff;
+
+    if(!partial)
+    {
+        reset_pl();
+    }
+
+    uint32_t len = size < chunk_size ? size : chunk_size;
+    uint32_t idx = 0;
+
+    if(crc)
+    {
+        qspi.read_crc(addr, buf[0], len, *crc);
+    }
+    else
+    {
+        qspi.read(addr, buf[0], len);
+    }
+    dcache_clean(buf[0], len);
+
+    for(uint32_t done = 0; ; )
+    {
+        const uint32_t NEXT = done + len;
+        start_dma(buf[idx], len, NEXT == size);
+
+        if(NEXT == size)
+            break;
+
+        //  fill the other buffer while DMA is running
+        idx ^= 1;
+        len  = size - NEXT < chunk_size ? size - NEXT : chunk_size;
+        if(crc)
+        {
+            qspi.read_crc(addr + NEXT, buf[idx], len, *crc);
+        }
+        else
+        {
+            qspi.read(addr + NEXT, buf[idx], len);
+        }
+        dcache_clean(buf[idx], len);
+
+        if(!wait_int(INT_DMA_DONE))
+            return false;
+
+        regs->INT_STS = INT_D_P_DONE;               // only the last one matters
+        done = NEXT;
+    }
+
+    if(!wait_int(INT_DMA_DONE | INT_D_P_DONE))
+        return false;
+
+    return partial || wait_int(INT_PCFG_DONE);
+}
+//------------------------------------------------------------------------------
+//
+//    PROG_B pulse clears PL configuration memory, PCFG_INIT goes low while
+//    the memory is being cleared
+//
+void Pcap::reset_pl()
+{
+    regs->CTRL |=  CTRL_PCFG_PROG_B;
+    regs->CTRL &= ~CTRL_PCFG_PROG_B;
+    while(regs->STATUS & STATUS_PCFG_INIT) { }
+
+    regs->CTRL |=  CTRL_PCFG_PROG_B;
+    while( !(regs->STATUS & STATUS_PCFG_INIT) ) { }
+
+    regs->INT_STS = INT_PCFG_DONE;
+}
+//------------------------------------------------------------------------------
+//
+//    Waits for all the bits of 'mask', clears them. Returns false on error
+//
+bool Pcap::wait_int(const uint32_t mask)
+{
+    for(;;)
+    {
+        const uint32_t STS = regs->INT_STS;
+        if(STS & INT_ERRORS)
+        {
+            err = STS & INT_ERRORS;
+            regs->INT_STS = err;
+            return false;
+        }
+        if( (STS & mask) == mask )
+        {
+            regs->INT_STS = mask;
+            return true;
+        }
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Lengths are in words, writing DMA_DEST_LEN queues the command. Address
+//    LSBs of the last command are set to 01: DMA done is signalled after PCAP
+//    has consumed the data
+//
+void Pcap::start_dma(const uint8_t *src, const uint32_t size, const bool last)
+{
+    const uint32_t FLAG  = last ? 1 : 0;
+    const uint32_t WORDS = size/sizeof(uint32_t);
+
+    while(regs->STATUS & STATUS_DMA_CMD_Q_F) { }
+
+    regs->DMA_SRC_ADDR = reinterpret_cast<uintptr_t>(src) | FLAG;
+    regs->DMA_DST_ADDR = PCAP_DST;
+    regs->DMA_SRC_LEN  = WORDS;
+    regs->DMA_DEST_LEN = WORDS;
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,147 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi PCAP Bitstream Loader Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7PCAP_H
+#define PS7PCAP_H
+
+#include <stdint.h>
+#include <z7common.h>
+#include "z7qspi.h"
+
+//------------------------------------------------------------------------------
+//
+//    PL configuration from QSPI flash via PCAP (Device Configuration
+//    Interface)
+//
+//    Notes:
+//    ~~~~~
+//    load() streams the bitstream through two buffers supplied by the user's
+//    software: while DEVC DMA sends one buffer to PCAP, the next chunk is read
+//    from flash into the other one, so the configuration time is about
+//    max(flash read time, PCAP time) instead of their sum.
+//
+//        * full configuration: PL is cleared by PROG_B pulse, the function
+//          waits for PCFG_DONE;
+//        * partial reconfiguration: PL is not cleared, the function waits
+//          for DMA and PCAP done (D_P_DONE) of the last transfer.
+//
+//    Bitstream is .bin image (no .bit header), size is multiple of 4. The
+//    last DMA command has the address LSBs set to wait for PCAP completion.
+//    Buffers must be cache line aligned, chunk size must be multiple of
+//    CACHE_LINE_SIZE; buffers are cleaned from data cache before DMA.
+//
+//    If 'crc' is not null, CRC-32 of the bitstream is computed on the fly
+//    (Qspi::read_crc), so the image can be verified at no extra pass.
+//
+//    PS-PL level shifters must be enabled by the user's software (usually by
+//    ps7_init) before load().
+//
+class Pcap
+{
+public:
+    struct Regs
+    {
+        uint32_t CTRL;                  //  0x000    rw    Control Register
+        uint32_t LOCK;                  //  0x004    rw    Locks for the Control Register
+        uint32_t CFG;                   //  0x008    rw    Configuration Register
+        uint32_t INT_STS;               //  0x00c    rw    Interrupt Status Register
+        uint32_t INT_MASK;              //  0x010    rw    Interrupt Mask Register
+        uint32_t STATUS;                //  0x014    rw    Miscellaneous Status Register
+        uint32_t DMA_SRC_ADDR;          //  0x018    rw    DMA Source Address Register
+        uint32_t DMA_DST_ADDR;          //  0x01c    rw    DMA Destination Address Register
+        uint32_t DMA_SRC_LEN;           //  0x020    rw    DMA Source Transfer Length
+        uint32_t DMA_DEST_LEN;          //  0x024    rw    DMA Destination Transfer Length
+        uint32_t RESERVED0;             //
+        uint32_t MULTIBOOT_ADDR;        //  0x02c    rw    Multi-Boot Address Pointer
+        uint32_t RESERVED1;             //
+        uint32_t UNLOCK;                //  0x034    rw    Unlock Control Register
+        uint32_t RESERVED2[18];         //
+        uint32_t MCTRL;                 //  0x080    rw    Miscellaneous Control Register
+    };
+
+    enum CtrlBits
+    {
+        CTRL_PCFG_PROG_B     = 1ul << 30,
+        CTRL_PCAP_PR         = 1ul << 27,      // PCAP (1) or ICAP (0) for configuration
+        CTRL_PCAP_MODE       = 1ul << 26,
+        CTRL_PCAP_RATE_EN    = 1ul << 25       // quarter rate, encrypted bitstreams
+    };
+
+    enum IntBits
+    {
+        INT_DMA_DONE         = 1ul << 13,
+        INT_D_P_DONE         = 1ul << 12,
+        INT_PCFG_DONE        = 1ul << 2,
+        INT_ERRORS           = 0x00f0f860      // AXI, DMA, PCAP, HMAC, SEU errors
+    };
+
+    enum StatusBits
+    {
+        STATUS_DMA_CMD_Q_F   = 1ul << 31,
+        STATUS_PCFG_INIT     = 1ul << 4
+    };
+
+    static const uintptr_t DEVC_ADDR       = 0xf8007000;
+    static const uint32_t  UNLOCK_KEY      = 0x757bdf0d;
+    static const uint32_t  MCTRL_PCAP_LPBK = 1ul << 4;
+    static const uint32_t  PCAP_DST        = 0xffffffff;
+
+public:
+    Pcap(Qspi &q, void *buf0, void *buf1, const uint32_t chunk, const uintptr_t addr = DEVC_ADDR)
+        : regs( reinterpret_cast<Regs*>(addr) )
+        , qspi(q)
+        , chunk_size(chunk & ~(CACHE_LINE_SIZE - 1))
+        , err(0)
+    {
+        buf[0] = reinterpret_cast<uint8_t *>(buf0);
+        buf[1] = reinterpret_cast<uint8_t *>(buf1);
+    }
+
+    void     init();
+    bool     load(const uint32_t addr, const uint32_t size, const bool partial = false, uint32_t *crc = 0);
+    bool     done()   const { return regs->INT_STS & INT_PCFG_DONE; }
+    uint32_t errors() const { return err; }         // INT_STS error bits of the last load()
+
+private:
+    void     reset_pl();
+    bool     wait_int(const uint32_t mask);
+    void     start_dma(const uint8_t *src, const uint32_t size, const bool last);
+
+private:
+    volatile Regs  *regs;
+    Qspi           &qspi;
+    uint8_t        *buf[2];
+    const uint32_t  chunk_size;
+    uint32_t        err;
+};
+//------------------------------------------------------------------------------
+
+#endif  // PS7PCAP_H
@@ -29,10 +29,26 @@
 //
 //------------------------------------------------------------------------------
 
+#include <string.h>
 #include <z7qspi.h>
+#include <z7crc32.h>
 
 //------------------------------------------------------------------------------
-void Qspi::init(bool manmode)
+//
+//    Packed timing value:
+//
+//        [2:0]   baud rate divider
+//        [13:8]  QSPI_LPBK_DLY_ADJ_REG image
+//        [31:16] TIMING_MAGIC
+//
+static const uint32_t TIMING_MAGIC = 0x5154;    // "QT"
+
+static const uint32_t SFDP_SIGNATURE = 0x50444653;  // "SFDP"
+static const uint32_t SFDP_BFPT_MIN  = 9;           // JESD216 BFPT length, dwords
+static const uint32_t SFDP_BFPT_MAX  = 16;          // JESD216B BFPT length, dwords
+
+//------------------------------------------------------------------------------
+void Qspi::init(bool manmode, const Topology topology, const uint32_t size)
 {
     wpa(QSPI_EN_REG, 0); // disable QSPI module
 
@@ -45,9 +61,20 @@ void Qspi::init(bool manmode)
 
     wpa(QSPI_RX_THRES_REG, 1);
     wpa(QSPI_TX_THRES_REG, 1);
+    wpa(QSPI_LPBK_DLY_ADJ_REG, 0);
+    lpbk_cfg = 0;
 
     // set up configuration
-    cbpa(QSPI_LQSPI_CFG_REG, QSPI_LQ_MODE_MASK);  // turn off linear mode
+    topo       = topology;
+    dev_size   = size ? size : LINEAR_SIZE;
+    upper      = false;
+    bg_upper   = false;
+    set_default_geometry();
+
+    wpa(QSPI_LQSPI_CFG_REG, two_mem_cfg());       // turn off linear mode, select device(s)
+    lq_cfg    = 0;
+    bg_op     = bgNONE;
+    bg_lq_cfg = 0;
 
     const uint32_t MAN_MODE = manmode ? (QSPI_MAN_START_EN_MASK | QSPI_MANUAL_CS_MASK) : 0;
     const uint32_t SET_MASK = QSPI_IFMODE_MASK     +     //  flash interface in Flash I/O Mode
@@ -73,11 +100,180 @@ void Qspi::init(bool manmode)
     wpa(QSPI_CONFIG_REG, cfg_reg);
     wpa(QSPI_EN_REG, 1);                            // enable QSPI module
 
+    if(manmode)
+    {
+        sfdp_probe();
+        if(size)
+        {
+            dev_size = size;                        // caller's value takes precedence
+        }
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Returns false if SFDP is not supported, the current settings are kept
+//    in this case
+//
+bool Qspi::sfdp_probe()
+{
+    if(topo == topoDUAL_PARALLEL)
+        return false;
+
+    wait();
+
+    IoMode io(*this);
+
+    set_upper(false);
+
+    //  SFDP header and the first parameter header which is BFPT
+    uint32_t hdr[4];
+    read_sfdp(0, hdr, 4);
+
+    const uint32_t BFPT_LEN = hdr[2] >> 24;
+    if(hdr[0] != SFDP_SIGNATURE || (hdr[2] & 0xff) != 0 || BFPT_LEN < SFDP_BFPT_MIN)
+        return false;
+
+    uint32_t bfpt[SFDP_BFPT_MAX];
+    const uint32_t LEN = BFPT_LEN < SFDP_BFPT_MAX ? BFPT_LEN : SFDP_BFPT_MAX;
+    read_sfdp(hdr[3] & 0xffffff, bfpt, LEN);
+
+    const uint32_t D1 = bfpt[0];
+    if( ((D1 >> 17) & 0x3) == 0x2 )
+        return false;                       // 4-byte addressing only
+
+    //  density
+    const uint32_t D2 = bfpt[1];
+    uint32_t       size;
+    if(D2 & (1ul << 31))
+    {
+        const uint32_t N = D2 & 0x7fffffff;
+        size = N >= 3 && N < 35 ? 1ul << (N - 3) : 0;   // 2^N bits
+    }
+    else
+    {
+        size = D2/8 + 1;
+    }
+    dev_size = size && size < LINEAR_SIZE ? size : LINEAR_SIZE;
+
+    //  read command: the fastest mode with the standard opcode
+    const uint32_t D3 = bfpt[2];
+    const uint32_t QIOR_MODE = (D3 >> 5) & 0x7;
+    const uint32_t QIOR_CLK  = (D3 & 0x1f) + QIOR_MODE;
+    const uint32_t QOR_CLK   = ((D3 >> 16) & 0x1f) + ((D3 >> 21) & 0x7);
 
+    rd_cmd     = cmdFAST_READ;
+    qor_dummy  = 1;
+    mode_bits  = false;
+    if( (D1 & (1ul << 22)) && (D3 >> 24) == cmdQOR && QOR_CLK && QOR_CLK%8 == 0 )
+    {
+        rd_cmd    = cmdQOR;
+        qor_dummy = QOR_CLK/8;
+    }
+    if( (D1 & (1ul << 21)) && ((D3 >> 8) & 0xff) == cmdQIOR && QIOR_CLK >= 2 && QIOR_CLK%2 == 0 )
+    {
+        rd_cmd     = cmdQIOR;
+        qior_dummy = QIOR_CLK/2 - 1;        // the first byte is the mode byte
+        mode_bits  = QIOR_MODE >= 2;
+    }
+
+    //  erase types, largest first
+    uint32_t n = 0;
+    for(uint32_t i = 0; i < MAX_ERASE_TYPES; ++i)
+    {
+        const uint32_t D = bfpt[7 + i/2] >> (i%2)*16;
+        const uint32_t N = D & 0xff;
+        if(N == 0 || N > 24)
+            continue;
+
+        EraseType t = { 1u << N, static_cast<CommandCode>((D >> 8) & 0xff) };
+        uint32_t  j = n++;
+        for( ; j && erase_tab[j - 1].size < t.size; --j)
+        {
+            erase_tab[j] = erase_tab[j - 1];
+        }
+        erase_tab[j] = t;
+    }
+    if(n)
+    {
+        erase_count = n;
+    }
+
+    //  page size
+    if(LEN >= 11)
+    {
+        const uint32_t PAGE = 1ul << ((bfpt[10] >> 4) & 0xf);
+        page_bytes = PAGE < MAX_PAGE_SIZE*sizeof(uint32_t) ? PAGE : MAX_PAGE_SIZE*sizeof(uint32_t);
+    }
+
+    return true;
+}
+//------------------------------------------------------------------------------
+//
+//    'count' is in words, up to 16; address is followed by 8 dummy clocks
+//
+void Qspi::read_sfdp(const uint32_t addr, uint32_t *dst, const uint32_t count)
+{
+    wpa(QSPI_RX_THRES_REG, count + 2);
+    cs_on();
+    wpa(QSPI_TXD1_REG, cmdRDSFDP);
+    wpa(QSPI_TXD0_REG, __builtin_bswap32(addr) >> 8);
+    fill_tx_fifo(count);
+    start_transfer();
+    while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
+    cs_off();
+
+    rpa(QSPI_RX_DATA_REG);                          // command/address responses
+    rpa(QSPI_RX_DATA_REG);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        dst[i] = rpa(QSPI_RX_DATA_REG);
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Returns logical erase block size for the command, 0 if the command is
+//    not in the erase table (say, chip erase)
+//
+uint32_t Qspi::erase_block_size(const CommandCode cmd) const
+{
+    const uint32_t SCALE = topo == topoDUAL_PARALLEL ? 2 : 1;
+
+    for(uint32_t i = 0; i < erase_count; ++i)
+    {
+        if(erase_tab[i].cmd == cmd)
+            return erase_tab[i].size*SCALE;
+    }
+    return 0;
+}
+//------------------------------------------------------------------------------
+//
+//    S25FL-S defaults, used if SFDP is not available
+//
+void Qspi::set_default_geometry()
+{
+    static const EraseType TYPES[] =
+    {
+        { 64*1024, cmdEB64K },
+        { 32*1024, cmdEB32K },
+        {  4*1024, cmdEB4K  }
+    };
+
+    erase_count = sizeof(TYPES)/sizeof(TYPES[0]);
+    for(uint32_t i = 0; i < erase_count; ++i)
+    {
+        erase_tab[i] = TYPES[i];
+    }
+
+    page_bytes = PAGE_SIZE*sizeof(uint32_t)*(topo == topoDUAL_PARALLEL ? 2 : 1);
+    qor_dummy  = 1;
+    qior_dummy = 2;
+    mode_bits  = true;
 }
 //------------------------------------------------------------------------------
 uint16_t Qspi::read_id()
 {
+    IoMode io(*this);
+
     wpa(QSPI_RX_THRES_REG, 2);
     cs_on();
     wpa(QSPI_TXD0_REG,  cmdREAD_ID);
@@ -89,10 +285,25 @@ uint16_t Qspi::read_id()
     return rpa(QSPI_RX_DATA_REG) >> 16;
 }
 //------------------------------------------------------------------------------
+//
+//    In dual parallel configuration each device returns its own status byte,
+//    the result is OR of both. The same applies to read_sr2()
+//
 uint8_t Qspi::read_sr1()
 {
+    IoMode io(*this);
+
     wpa(QSPI_RX_THRES_REG, 1);
     cs_on();
+    if(topo == topoDUAL_PARALLEL)
+    {
+        wpa(QSPI_TXD3_REG,  cmdRDSR1);
+        start_transfer();
+        while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
+        cs_off();
+        const uint32_t val = rpa(QSPI_RX_DATA_REG) >> 16;
+        return val | (val >> 8);
+    }
     wpa(QSPI_TXD2_REG,  cmdRDSR1);
     start_transfer();
     while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
@@ -102,8 +313,19 @@ uint8_t Qspi::read_sr1()
 //------------------------------------------------------------------------------
 uint8_t Qspi::read_sr2()
 {
+    IoMode io(*this);
+
     wpa(QSPI_RX_THRES_REG, 1);
     cs_on();
+    if(topo == topoDUAL_PARALLEL)
+    {
+        wpa(QSPI_TXD3_REG,  cmdRDSR2);
+        start_transfer();
+        while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
+        cs_off();
+        const uint32_t val = rpa(QSPI_RX_DATA_REG) >> 16;
+        return val | (val >> 8);
+    }
     wpa(QSPI_TXD2_REG,  cmdRDSR2);
     start_transfer();
     while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
@@ -113,6 +335,8 @@ uint8_t Qspi::read_sr2()
 //------------------------------------------------------------------------------
 void Qspi::write_sr2(uint8_t reg)
 {
+    IoMode io(*this);
+
     wren();
     wpa(QSPI_RX_THRES_REG, 1);
     cs_on();
@@ -125,6 +349,8 @@ void Qspi::write_sr2(uint8_t reg)
 //------------------------------------------------------------------------------
 uint8_t Qspi::wren()
 {
+    IoMode io(*this);
+
     wpa(QSPI_RX_THRES_REG, 1);
     cs_on();
     wpa(QSPI_TXD1_REG,  cmdWREN);
@@ -134,59 +360,247 @@ uint8_t Qspi::wren()
     return rpa(QSPI_RX_DATA_REG);
 }
 //------------------------------------------------------------------------------
+void Qspi::clsr()
+{
+    send_cmd(cmdCLSR);
+}
+//------------------------------------------------------------------------------
+void Qspi::send_cmd(const CommandCode cmd)
+{
+    wpa(QSPI_RX_THRES_REG, 1);
+    cs_on();
+    wpa(QSPI_TXD1_REG,  cmd);
+    start_transfer();
+    while( ! (rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
+    cs_off();
+    rpa(QSPI_RX_DATA_REG);
+}
+//------------------------------------------------------------------------------
 void Qspi::erase(const uint32_t addr, const CommandCode cmd)
 {
+    wait();
+
+    IoMode io(*this);
+
+    erase_cmd(addr, cmd);
+    while( wip() ) { }
+}
+//------------------------------------------------------------------------------
+//
+//    Erases all 4K sectors touched by the range [addr, addr + count) with
+//    minimal number of erase operations: the largest block that is aligned
+//    and fits into the rest of the range is chosen at each step. Blocks which
+//    are already blank are skipped.
+//
+//    Returns number of erase operations issued.
+//
+uint32_t Qspi::erase_range(const uint32_t addr, const uint32_t count)
+{
+    const EraseType *TYPES      = erase_tab;
+    const uint32_t   TYPE_COUNT = erase_count;
+    const uint32_t SCALE      = topo == topoDUAL_PARALLEL ? 2 : 1;   // logical block size
+    const uint32_t MIN_SIZE   = TYPES[TYPE_COUNT - 1].size*SCALE;
+
+    if(!count)
+        return 0;
+
+    uint32_t       a   = addr & ~(MIN_SIZE - 1);
+    const uint32_t END = (addr + count + MIN_SIZE - 1) & ~(MIN_SIZE - 1);
+    uint32_t       ops = 0;
+
+    while(a < END)
+    {
+        const EraseType *t = &TYPES[TYPE_COUNT - 1];
+        for(uint32_t i = 0; i < TYPE_COUNT; ++i)
+        {
+            const uint32_t SIZE = TYPES[i].size*SCALE;
+            if(a % SIZE == 0 && END - a >= SIZE)
+            {
+                t = &TYPES[i];
+                break;
+            }
+        }
+
+        const uint32_t SIZE = t->size*SCALE;
+        if(!is_blank(a, SIZE))
+        {
+            erase(a, t->cmd);
+            ++ops;
+        }
+        a += SIZE;
+    }
+
+    return ops;
+}
+//------------------------------------------------------------------------------
+//
+//    In linear mode the range is checked directly through the linear window,
+//    otherwise it is read by chunks
+//
+bool Qspi::is_blank(const uint32_t addr, const uint32_t count)
+{
+    const uint32_t WCOUNT = count/sizeof(uint32_t);
+
+    if(linear_mode())
+    {
+        const uint32_t *p = reinterpret_cast<const uint32_t *>(linear_window(addr));
+        for(uint32_t i = 0; i < WCOUNT; ++i)
+        {
+            if(p[i] != 0xffffffff)
+                return false;
+        }
+        return true;
+    }
+
+    uint32_t buf[PAGE_SIZE*4];
+    const uint32_t CHUNK = sizeof(buf)/sizeof(uint32_t);
+
+    for(uint32_t offs = 0; offs < WCOUNT; offs += CHUNK)
+    {
+        const uint32_t n = WCOUNT - offs < CHUNK ? WCOUNT - offs : CHUNK;
+
+        read(addr + offs*sizeof(uint32_t), buf, n*sizeof(uint32_t));
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            if(buf[i] != 0xffffffff)
+                return false;
+        }
+    }
+    return true;
+}
+//------------------------------------------------------------------------------
+void Qspi::erase_cmd(const uint32_t addr, const CommandCode cmd)
+{
+    uint32_t rev_addr = __builtin_bswap32( dev_addr(addr) ) >> 8;
+
     wren();
     wpa(QSPI_RX_THRES_REG, 1);
     cs_on();
-    uint32_t rev_addr = __builtin_bswap32(addr) >> 8;
     wpa(QSPI_TXD0_REG,  cmd + ( rev_addr << 8) );
     start_transfer();
     while( ! (rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
     cs_off();
     rpa(QSPI_RX_DATA_REG);
+}
+//------------------------------------------------------------------------------
+//
+//    Page program of arbitrary length within the page: command/address word
+//    and data are pushed to TX FIFO by chunks, FIFO is refilled when its level
+//    drops below TX_REFILL_LEVEL
+//
+void Qspi::program(const uint32_t addr, const uint8_t *data, const uint32_t count)
+{
+    program_cmd(addr, data, count);
     while( wip() ) { }
 }
 //------------------------------------------------------------------------------
-void Qspi::program_page(const uint32_t addr, const uint32_t *data)
+void Qspi::program_cmd(const uint32_t addr, const uint8_t *data, const uint32_t count)
 {
+    const uint32_t TX_REFILL_LEVEL = 16;
+
+    uint32_t rev_addr = __builtin_bswap32( dev_addr(addr) ) >> 8;
+
     wren();
     cs_on();
-    uint32_t rev_addr = __builtin_bswap32(addr) >> 8;
     wpa(QSPI_TXD0_REG,  cmdQPP + ( rev_addr << 8) );
 
-    const uint32_t CHUNK0 = 16;
-    const uint32_t CHUNK1 = PAGE_SIZE - CHUNK0;
-
-
-    wpa( QSPI_TX_THRES_REG, FIFO_SIZE -  CHUNK1 );
-    write_tx_fifo(data, CHUNK0);
-
+    uint32_t pushed = write_tx_bytes(data, count, FIFO_SIZE - 1);
     start_transfer();
 
-    while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK) ) { }
-    flush_rx_fifo();
-    write_tx_fifo(data + CHUNK0, CHUNK1);
-    start_transfer();
+    while(pushed < count)
+    {
+        wpa(QSPI_TX_THRES_REG, TX_REFILL_LEVEL);
+        while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK) ) { }
+        flush_rx_fifo();
+        pushed += write_tx_bytes(data + pushed, count - pushed, FIFO_SIZE - TX_REFILL_LEVEL);
+        start_transfer();
+    }
 
     wpa(QSPI_TX_THRES_REG, 1);
     while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK) ) { }
 
     cs_off();
     flush_rx_fifo();
-    while( wip() ) { }
 }
 //------------------------------------------------------------------------------
-void Qspi::write(const uint32_t addr, const void *data, const uint32_t count)
+//
+//    Writes data of any length at any address. Data is split at page
+//    boundaries, each page range is read back first and:
+//
+//        * is skipped if flash already holds the data;
+//        * only the span from the first to the last changed byte is programmed;
+//        * is skipped if some bit has to go 0->1, which requires erase,
+//          in this case the function returns false.
+//
+bool Qspi::write(const uint32_t addr, const void *data, const uint32_t count)
 {
-    const uint32_t WCOUNT = count/4 + (count%4 ? 1 : 0);
-    const uint32_t CHUNKS = WCOUNT/PAGE_SIZE + (WCOUNT%PAGE_SIZE ? 1 : 0);
-    const uint32_t *p     = reinterpret_cast<const uint32_t *>(data);
+    const uint32_t PAGE_BYTES = page_bytes;
+    const uint8_t *src        = reinterpret_cast<const uint8_t *>(data);
+    bool           res        = true;
+
+    wait();
+
+    IoMode io(*this);
 
-    for(uint32_t i = 0; i < CHUNKS; ++i)
+    for(uint32_t done = 0; done < count; )
     {
-        program_page(addr + i*PAGE_SIZE*sizeof(uint32_t), p + i*PAGE_SIZE);
+        const uint32_t ADDR = addr + done;
+        uint32_t       len  = PAGE_BYTES - ADDR%PAGE_BYTES;
+        if(len > count - done)
+        {
+            len = count - done;
+        }
+
+        uint32_t       page[MAX_PAGE_SIZE];
+        const uint8_t *cur = reinterpret_cast<const uint8_t *>(page);
+        const uint8_t *p   = src + done;
+
+        read(ADDR, page, len);
+
+        uint32_t first = len;
+        uint32_t last  = 0;
+        bool     blank = true;                   // no 0->1 transitions
+        for(uint32_t i = 0; i < len; ++i)
+        {
+            if(cur[i] != p[i])
+            {
+                if(p[i] & ~cur[i])
+                {
+                    blank = false;
+                    break;
+                }
+                if(first == len)
+                {
+                    first = i;
+                }
+                last = i;
+            }
+        }
+
+        if(!blank)
+        {
+            res = false;
+        }
+        else if(first < len && topo == topoDUAL_PARALLEL)
+        {
+            // devices are programmed by byte pairs: widen the span to even
+            // bounds, added bytes are reprogrammed with their flash content
+            const uint32_t FROM = (ADDR + first) & ~1ul;
+            const uint32_t TO   = (ADDR + last + 2) & ~1ul;
+            uint8_t       *buf  = reinterpret_cast<uint8_t *>(page);
+
+            read(FROM, buf, TO - FROM);
+            memcpy(buf + (ADDR + first - FROM), p + first, last - first + 1);
+            program(FROM, buf, TO - FROM);
+        }
+        else if(first < len)
+        {
+            program(ADDR + first, p + first, last - first + 1);
+        }
+        done += len;
     }
+
+    return res;
 }
 //------------------------------------------------------------------------------
 uint32_t Qspi::read(const uint32_t addr, void * const pdst, uint32_t count)
@@ -194,26 +608,74 @@ uint32_t Qspi::read(const uint32_t addr, void * const pdst, uint32_t count)
     if(!count)
         return 0;
 
+    if(bg_op != bgNONE && suspend())
+    {
+        const uint32_t res = read_io(addr, pdst, count);
+        resume();
+        return res;
+    }
+
+    if(linear_mode())
+    {
+        memcpy(pdst, linear_window(addr), count);
+        return count;
+    }
+
+    return read_io(addr, pdst, count);
+}
+//------------------------------------------------------------------------------
+//
+//    In I/O mode CRC is computed by read_rx_fifo_crc() as the FIFO is
+//    drained, in linear mode - while data are copied from the window
+//
+uint32_t Qspi::read_crc(const uint32_t addr, void * const pdst, const uint32_t count, uint32_t &crc)
+{
+    if(linear_mode())
+    {
+        const uint8_t *src = linear_window(addr);
+        uint8_t       *dst = reinterpret_cast<uint8_t *>(pdst);
+        uint32_t       c   = ~crc;
+
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            const uint8_t b = src[i];
+            dst[i] = b;
+            c      = crc32_byte(c, b);
+        }
+        crc = ~c;
+        return count;
+    }
+
+    crc_val  = ~crc;
+    crc_left = count;
+
+    const uint32_t res = read(addr, pdst, count);
+
+    crc      = ~crc_val;
+    crc_left = 0;
+
+    return res;
+}
+//------------------------------------------------------------------------------
+uint32_t Qspi::read_io(const uint32_t addr, void * const pdst, uint32_t count)
+{
     uint8_t * const dst = reinterpret_cast<uint8_t * const>(pdst);
 
-    cs_on();
+    if(topo == topoDUAL_STACKED && addr < dev_size && addr + count > dev_size)
+    {
+        const uint32_t n = dev_size - addr;
+        read_io(addr, dst, n);
+        return n + read_io(dev_size, dst + n, count - n);
+    }
 
-    // issue command/address
-    wpa(QSPI_RX_THRES_REG, 1);
-    wpa(QSPI_TXD1_REG,  cmdQOR);
-    start_transfer();
-    while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
-    rpa(QSPI_RX_DATA_REG);      // drop command/address response
+    const uint32_t DEV_ADDR = dev_addr(addr);
 
-    uint32_t rev_addr = __builtin_bswap32(addr);
-    wpa(QSPI_TXD0_REG, rev_addr >> 8 );
-    start_transfer();
-    while( !(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
-    rpa(QSPI_RX_DATA_REG);      // drop dummy data response
+    cs_on();
 
-    // data transfer
+    uint32_t skip   = read_cmd(DEV_ADDR);                 // command/address responses
     uint32_t wcount = count/4 + (count%4 ? 1 : 0);
 
+    // data transfer
     uint32_t rchunk;
     uint32_t rx_idx = 0;
     for(;;)
@@ -230,10 +692,15 @@ uint32_t Qspi::read(const uint32_t addr, void * const pdst, uint32_t count)
         }
         start_transfer();
         
-        wpa(QSPI_RX_THRES_REG, rchunk);
+        wpa(QSPI_RX_THRES_REG, rchunk + skip);
 
         while(!(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK)) { }
         while(!(rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK)) { }
+
+        for( ; skip; --skip)
+        {
+            rpa(QSPI_RX_DATA_REG);
+        }
         
         read_rx_fifo(dst + rx_idx*sizeof(uint32_t), rchunk);
         rx_idx += rchunk;
@@ -249,6 +716,380 @@ uint32_t Qspi::read(const uint32_t addr, void * const pdst, uint32_t count)
     return rx_idx*sizeof(uint32_t);
 }
 //------------------------------------------------------------------------------
+//
+//    Puts read command, address, mode and dummy cycles into TX FIFO, returns
+//    number of FIFO entries whose responses must be dropped
+//
+//        cmdQOR:  address and qor_dummy bytes (8 clocks each by default) on
+//                 single line, the first dummy byte shares the address word
+//        cmdQIOR: address and mode byte 0xff (no continuous read) on four
+//                 lines, qior_dummy bytes (2 clocks each) on four lines
+//
+uint32_t Qspi::read_cmd(const uint32_t addr)
+{
+    const uint32_t rev_addr = __builtin_bswap32(addr) >> 8;
+
+    wpa(QSPI_TXD1_REG, rd_cmd);
+    if(rd_cmd == cmdQIOR)
+    {
+        wpa(QSPI_TXD0_REG, rev_addr + (0xfful << 24));
+        return 2 + push_dummy(qior_dummy);
+    }
+
+    wpa(QSPI_TXD0_REG, rev_addr);
+    return 2 + push_dummy(qor_dummy - 1);
+}
+//------------------------------------------------------------------------------
+//
+//    Returns number of TX FIFO entries used
+//
+uint32_t Qspi::push_dummy(uint32_t count)
+{
+    uint32_t n = 0;
+
+    for( ; count >= 4; count -= 4, ++n)
+    {
+        wpa(QSPI_TXD0_REG, 0);
+    }
+
+    switch(count)
+    {
+    case 1:  wpa(QSPI_TXD1_REG, 0); return n + 1;
+    case 2:  wpa(QSPI_TXD2_REG, 0); return n + 1;
+    case 3:  wpa(QSPI_TXD3_REG, 0); return n + 1;
+    default: return n;
+    }
+}
+//------------------------------------------------------------------------------
+void Qspi::set_clock(const uint32_t div, const uint32_t lpbk)
+{
+    wait();
+
+    IoMode io(*this);
+    set_clock_regs(div, lpbk);
+}
+//------------------------------------------------------------------------------
+uint32_t Qspi::timing() const
+{
+    const uint32_t DIV = (cfg_reg & QSPI_BAUD_RATE_DIV_MASK) >> QSPI_BAUD_RATE_DIV_BPOS;
+
+    return (TIMING_MAGIC << 16) + (lpbk_cfg << 8) + DIV;
+}
+//------------------------------------------------------------------------------
+bool Qspi::set_timing(const uint32_t t)
+{
+    if(t >> 16 != TIMING_MAGIC)
+        return false;
+
+    set_clock(t & 0x7, (t >> 8) & 0x3f);
+    return true;
+}
+//------------------------------------------------------------------------------
+//
+//    'count' is in bytes, limited to MAX_PAGE_SIZE*4 bytes (verify_read()
+//    compares byte counts against a page buffer); the block at 'addr' must not
+//    be uniform (say, all 0xff) - otherwise timing errors can not be detected
+//
+uint32_t Qspi::calibrate(const uint32_t addr, uint32_t count, const void *pattern)
+{
+    const uint32_t DLY_STEPS = 8;               // DLY0 field values
+
+    uint32_t ref[MAX_PAGE_SIZE];
+
+    wait();
+
+    IoMode io(*this);
+
+    if(count > sizeof(ref))
+    {
+        count = sizeof(ref);
+    }
+
+    uint32_t best = timing();
+    uint32_t div  = best & 0x7;
+
+    if(pattern)
+    {
+        memcpy(ref, pattern, count);
+    }
+    else
+    {
+        read_io(addr, ref, count);
+    }
+
+    while(div > 1)                              // no loopback clock required
+    {
+        set_clock_regs(div - 1, 0);
+        if(!verify_read(addr, ref, count))
+            break;
+
+        --div;
+        best = timing();
+    }
+
+    if(div == 1)
+    {
+        uint32_t run_start = 0;
+        uint32_t run_len   = 0;
+        uint32_t best_len  = 0;
+        uint32_t best_dly  = 0;
+
+        for(uint32_t dly = 0; dly < DLY_STEPS; ++dly)
+        {
+            set_clock_regs(0, QSPI_USE_LPBK_MASK + (dly << QSPI_DLY0_BPOS));
+            if(verify_read(addr, ref, count))
+            {
+                if(!run_len++)
+                {
+                    run_start = dly;
+                }
+                if(run_len > best_len)
+                {
+                    best_len = run_len;
+                    best_dly = run_start + (run_len - 1)/2;
+                }
+            }
+            else
+            {
+                run_len = 0;
+            }
+        }
+
+        if(best_len)
+        {
+            set_clock_regs(0, QSPI_USE_LPBK_MASK + (best_dly << QSPI_DLY0_BPOS));
+            best = timing();
+        }
+    }
+
+    set_clock_regs(best & 0x7, (best >> 8) & 0x3f);
+    return best;
+}
+//------------------------------------------------------------------------------
+void Qspi::set_clock_regs(const uint32_t div, const uint32_t lpbk)
+{
+    wpa(QSPI_EN_REG, 0);
+
+    cfg_reg &= ~QSPI_BAUD_RATE_DIV_MASK;
+    cfg_reg |=  (div << QSPI_BAUD_RATE_DIV_BPOS) & QSPI_BAUD_RATE_DIV_MASK;
+    lpbk_cfg =  lpbk;
+
+    wpa(QSPI_CONFIG_REG, cfg_reg);
+    wpa(QSPI_LPBK_DLY_ADJ_REG, lpbk_cfg);
+    wpa(QSPI_EN_REG, 1);
+}
+//------------------------------------------------------------------------------
+//
+//    Data is read twice to reduce probability of occasional match
+//
+bool Qspi::verify_read(const uint32_t addr, const uint32_t *ref, const uint32_t count)
+{
+    uint32_t buf[MAX_PAGE_SIZE];
+
+    for(uint32_t i = 0; i < 2; ++i)
+    {
+        read_io(addr, buf, count);
+        if(memcmp(buf, ref, count))
+            return false;
+    }
+    return true;
+}
+//------------------------------------------------------------------------------
+void Qspi::erase_start(const uint32_t addr, const CommandCode cmd)
+{
+    wait();
+    start_bg(bgERASE);
+    erase_cmd(addr, cmd);
+    bg_upper = upper;
+}
+//------------------------------------------------------------------------------
+//
+//    Programs data within a single page, returns false if the range crosses
+//    the page boundary
+//
+bool Qspi::program_start(const uint32_t addr, const void *data, const uint32_t count)
+{
+    const uint32_t PAGE_BYTES = page_bytes;
+
+    if(!count || addr%PAGE_BYTES + count > PAGE_BYTES)
+        return false;
+
+    wait();
+    start_bg(bgPROGRAM);
+    program_cmd(addr, reinterpret_cast<const uint8_t *>(data), count);
+    bg_upper = upper;
+    return true;
+}
+//------------------------------------------------------------------------------
+bool Qspi::busy()
+{
+    if(bg_op == bgNONE)
+        return false;
+
+    set_upper(bg_upper);
+    if(wip())
+        return true;
+
+    complete_bg();
+    return false;
+}
+//------------------------------------------------------------------------------
+void Qspi::start_bg(const BackgroundOp op)
+{
+    bg_lq_cfg = lq_cfg;
+    if(bg_lq_cfg)
+    {
+        linear_mode_off();
+    }
+    bg_op = op;
+}
+//------------------------------------------------------------------------------
+void Qspi::complete_bg()
+{
+    bg_op = bgNONE;
+    if(bg_lq_cfg)
+    {
+        set_lq_cfg(bg_lq_cfg);
+        bg_lq_cfg = 0;
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Returns true if background operation is suspended, false if it has been
+//    completed - in this case background operation state is cleared
+//
+bool Qspi::suspend()
+{
+    set_upper(bg_upper);
+    if(!wip())
+    {
+        complete_bg();
+        return false;
+    }
+
+    send_cmd(bg_op == bgERASE ? cmdERSP : cmdPGSP);
+    while( wip() ) { }                              // suspend latency
+
+    if( !(read_sr2() & (ES | PS)) )                 // completed before suspend
+    {
+        complete_bg();
+        return false;
+    }
+    return true;
+}
+//------------------------------------------------------------------------------
+void Qspi::resume()
+{
+    set_upper(bg_upper);
+    send_cmd(bg_op == bgERASE ? cmdERRS : cmdPGRS);
+}
+//------------------------------------------------------------------------------
+//
+//    Linear mode read instruction setup:
+//
+//        cmdQOR:  qor_dummy bytes on single line (8 clocks each)
+//        cmdQIOR: mode byte and qior_dummy bytes on four lines (2 clocks
+//                 each), mode byte is 0xa0 for continuous read, 0xff
+//                 otherwise; continuous read requires flash mode bits
+//
+void Qspi::linear_mode_on(const CommandCode cmd, const bool continuous)
+{
+    uint32_t cfg = QSPI_LQ_MODE_MASK + two_mem_cfg() + cmd;
+
+    if(cmd == cmdQIOR)
+    {
+        const uint32_t MODE = continuous && mode_bits ? QSPI_MODE_ON_MASK + (0xa0ul << QSPI_MODE_BITS_BPOS)
+                                                      : 0xfful << QSPI_MODE_BITS_BPOS;
+
+        cfg += QSPI_MODE_EN_MASK + MODE + (static_cast<uint32_t>(qior_dummy) << QSPI_DUMMY_BYTE_BPOS);
+    }
+    else
+    {
+        cfg += static_cast<uint32_t>(qor_dummy) << QSPI_DUMMY_BYTE_BPOS;
+    }
+
+    set_lq_cfg(cfg);
+}
+//------------------------------------------------------------------------------
+void Qspi::linear_mode_off()
+{
+    const bool CONTINUOUS = lq_cfg & QSPI_MODE_ON_MASK;
+
+    wpa(QSPI_EN_REG, 0);
+    wpa(QSPI_LQSPI_CFG_REG, two_mem_cfg());
+    lq_cfg = 0;
+    upper  = false;
+
+    wpa(QSPI_CONFIG_REG, cfg_reg);                  // restore I/O mode settings
+    wpa(QSPI_EN_REG, 1);
+
+    if(CONTINUOUS)                                  // flash waits for address, not opcode
+    {
+        wpa(QSPI_RX_THRES_REG, 1);
+        cs_on();
+        wpa(QSPI_TXD0_REG, cmdMBR*0x01010101ul);    // Mode Bit Reset, 32 clocks of 1s
+        start_transfer();
+        while( ! (rpa(QSPI_INT_STS_REG) & QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) ) { }
+        cs_off();
+        rpa(QSPI_RX_DATA_REG);
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Linear mode requires hardware controlled nCS and automatic start, I/O mode
+//    settings are kept in cfg_reg and restored by linear_mode_off()
+//
+void Qspi::set_lq_cfg(const uint32_t cfg)
+{
+    wpa(QSPI_EN_REG, 0);
+
+    uint32_t reg = cfg_reg & ~(QSPI_MAN_START_EN_MASK | QSPI_MANUAL_CS_MASK | QSPI_PCS_MASK);
+    wpa(QSPI_CONFIG_REG, reg);
+    wpa(QSPI_LQSPI_CFG_REG, cfg);
+    lq_cfg = cfg;
+
+    wpa(QSPI_EN_REG, 1);
+}
+//------------------------------------------------------------------------------
+uint32_t Qspi::two_mem_cfg() const
+{
+    switch(topo)
+    {
+    case topoDUAL_PARALLEL: return QSPI_TWO_MEM_MASK | QSPI_SEP_BUS_MASK;
+    case topoDUAL_STACKED:  return QSPI_TWO_MEM_MASK;
+    default:                return 0;
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Converts logical address to device address, selects the device in
+//    stacked configuration
+//
+uint32_t Qspi::dev_addr(const uint32_t addr)
+{
+    switch(topo)
+    {
+    case topoDUAL_PARALLEL:
+        return addr/2;
+
+    case topoDUAL_STACKED:
+        set_upper(addr >= dev_size);
+        return upper ? addr - dev_size : addr;
+
+    default:
+        return addr;
+    }
+}
+//------------------------------------------------------------------------------
+void Qspi::set_upper(const bool u)
+{
+    if(topo != topoDUAL_STACKED || u == upper)
+        return;
+
+    upper = u;
+    wpa(QSPI_LQSPI_CFG_REG, two_mem_cfg() | (u ? QSPI_U_PAGE_MASK : 0));
+}
+//------------------------------------------------------------------------------
 void Qspi::fill_tx_fifo(const uint32_t count, const uint32_t pattern)
 {
     for(uint32_t i = 0; i < count; ++i)
@@ -265,16 +1106,143 @@ void Qspi::write_tx_fifo(const uint32_t *data, const uint32_t count)
     }
 }
 //------------------------------------------------------------------------------
+//
+//    Pushes up to 'max_words' FIFO entries from 'data' to TX FIFO, trailing
+//    1..3 bytes go through TXD1..TXD3 registers. Returns number of bytes pushed
+//
+uint32_t Qspi::write_tx_bytes(const uint8_t *data, const uint32_t count, const uint32_t max_words)
+{
+    uint32_t pushed = 0;
+
+    for(uint32_t n = 0; n < max_words && pushed < count; ++n)
+    {
+        uint32_t       val  = 0;
+        const uint32_t REST = count - pushed;
+
+        if(REST >= sizeof(uint32_t))
+        {
+            memcpy(&val, data + pushed, sizeof(uint32_t));
+            wpa(QSPI_TXD0_REG, val);
+            pushed += sizeof(uint32_t);
+        }
+        else
+        {
+            memcpy(&val, data + pushed, REST);
+            switch(REST)
+            {
+            case 1:  wpa(QSPI_TXD1_REG, val); break;
+            case 2:  wpa(QSPI_TXD2_REG, val); break;
+            default: wpa(QSPI_TXD3_REG, val); break;
+            }
+            pushed += REST;
+        }
+    }
+
+    return pushed;
+}
+//------------------------------------------------------------------------------
+//
+//    Word-aligned destination: RX words are stored as is, by groups of four
+//    which compiler turns into single STM.
+//
+//    Unaligned destination: head bytes up to the word boundary are stored
+//    bytewise, then the rest of each RX word is merged with the next one and
+//    stored by words, the carried bytes of the last RX word are stored bytewise.
+//
 void Qspi::read_rx_fifo(uint8_t * const dst, const uint32_t count)
 {
+    if(!count)
+        return;
+
+    if(crc_left)
+    {
+        read_rx_fifo_crc(dst, count);
+        return;
+    }
+
+    const uint32_t OFFSET = reinterpret_cast<uintptr_t>(dst) % sizeof(uint32_t);
+
+    if(OFFSET == 0)
+    {
+        uint32_t *p = reinterpret_cast<uint32_t *>(dst);
+        uint32_t  i = 0;
+
+        for( ; i + 4 <= count; i += 4)
+        {
+            const uint32_t w0 = rpa(QSPI_RX_DATA_REG);
+            const uint32_t w1 = rpa(QSPI_RX_DATA_REG);
+            const uint32_t w2 = rpa(QSPI_RX_DATA_REG);
+            const uint32_t w3 = rpa(QSPI_RX_DATA_REG);
+            p[i + 0] = w0;
+            p[i + 1] = w1;
+            p[i + 2] = w2;
+            p[i + 3] = w3;
+        }
+        for( ; i < count; ++i)
+        {
+            p[i] = rpa(QSPI_RX_DATA_REG);
+        }
+        return;
+    }
+
+    const uint32_t HEAD  = sizeof(uint32_t) - OFFSET;     // bytes up to word boundary
+    const uint32_t SHIFT = HEAD*8;
+
+    uint32_t val = rpa(QSPI_RX_DATA_REG);
+    for(uint32_t i = 0; i < HEAD; ++i)
+    {
+        dst[i] = val >> i*8;
+    }
+
+    uint32_t  carry = val >> SHIFT;
+    uint32_t *p     = reinterpret_cast<uint32_t *>(dst + HEAD);
+
+    for(uint32_t i = 1; i < count; ++i)
+    {
+        val   = rpa(QSPI_RX_DATA_REG);
+        *p++  = carry | (val << (32 - SHIFT));
+        carry = val >> SHIFT;
+    }
+
+    uint8_t *tail = reinterpret_cast<uint8_t *>(p);
+    for(uint32_t i = 0; i < OFFSET; ++i)
+    {
+        tail[i] = carry >> i*8;
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    The last chunk of a read can contain padding bytes beyond the requested
+//    count, crc_left limits CRC to the requested data
+//
+void Qspi::read_rx_fifo_crc(uint8_t * const dst, const uint32_t count)
+{
+    uint32_t c = crc_val;
+
     for(uint32_t i = 0; i < count; ++i)
     {
         uint32_t val = rpa(QSPI_RX_DATA_REG);
-        dst[i*sizeof(uint32_t) + 0] = val;
-        dst[i*sizeof(uint32_t) + 1] = val >> 8;
-        dst[i*sizeof(uint32_t) + 2] = val >> 16;
-        dst[i*sizeof(uint32_t) + 3] = val >> 24;
+        memcpy(dst + i*sizeof(uint32_t), &val, sizeof(val));
+
+        if(crc_left >= sizeof(uint32_t))
+        {
+            c = crc32_byte(c, val);
+            c = crc32_byte(c, val >> 8);
+            c = crc32_byte(c, val >> 16);
+            c = crc32_byte(c, val >> 24);
+            crc_left -= sizeof(uint32_t);
+        }
+        else
+        {
+            for( ; crc_left; --crc_left)
+            {
+                c     = crc32_byte(c, val);
+                val >>= 8;
+            }
+        }
     }
+
+    crc_val = c;
 }
 //------------------------------------------------------------------------------
 void Qspi::flush_rx_fifo()
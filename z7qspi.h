@@ -33,6 +33,7 @@
 #define PS7QSPI_H
 
 #include "z7common.h"
+#include "z7dmac.h"
 #include <ps7mmrs.h>
 
 //------------------------------------------------------------------------------
@@ -69,14 +70,129 @@
 //    command is issued without manual asserting of nCS line, hardware controls
 //    nCS - asserts before data send/receive and deasserts after.
 //
+//    Linear Mode
+//    ~~~~~~~~~~~
+//    linear_mode_on() switches the controller to Linear Quad-SPI Mode: flash
+//    array is mapped to the AXI address space at LINEAR_ADDR and can be read
+//    with ordinary load instructions or memcpy, the controller issues read
+//    command, address and dummy cycles by itself; without explicit command
+//    the read command selected by sfdp_probe() (or set_read_cmd()) is used.
+//    While linear mode is on, read() is served from the linear window; erase()
+//    and write() temporarily switch the controller back to I/O mode and
+//    restore linear mode on exit.
+//
+//    Note: the controller does not know anything about data modified in flash,
+//    so if the linear window is mapped as cacheable memory the user's software
+//    must invalidate the cached lines after erase()/write().
+//
+//    Background Operations
+//    ~~~~~~~~~~~~~~~~~~~~~
+//    erase_start() and program_start() issue the command and return without
+//    waiting for flash to complete the operation, busy() polls the completion.
+//    While the operation is in progress, read() suspends it by erase/program
+//    suspend command, reads data and resumes the operation, so read latency
+//    does not depend on erase time. Data of the sector being erased/programmed
+//    must not be read - flash returns undefined data for it. Other flash
+//    modifying calls wait for the background operation completion. Linear mode
+//    is turned off while a background operation is in progress.
+//
+//    Read Commands
+//    ~~~~~~~~~~~~~
+//    read() in I/O mode uses Quad Output Read (cmdQOR) by default, the address
+//    is sent on one line. set_read_cmd(cmdQIOR) selects Quad I/O Read: address
+//    and mode byte are sent on four lines, so the command/address phase takes
+//    14 clocks instead of 40. Command, address, mode and dummy cycles are put
+//    into TX FIFO at once together with the first data chunk.
+//
+//    Continuous read (mode bits 0xA0) lets flash skip the opcode of the next
+//    read. The controller in I/O mode needs the opcode to switch bus width, so
+//    continuous read is available in linear mode: linear_mode_on(cmdQIOR, true),
+//    then the controller sends the opcode only once and each subsequent
+//    linear read starts with the address. linear_mode_off() brings the flash
+//    out of continuous read mode by Mode Bit Reset.
+//
+//    read_crc() computes CRC-32 of the data while RX FIFO is drained (or
+//    while data are copied from the linear window), so image verification
+//    does not need the second pass over the destination buffer. CRC covers
+//    exactly 'count' bytes and is chainable like crc32().
+//
+//    Clock and Read Timing
+//    ~~~~~~~~~~~~~~~~~~~~~
+//    set_clock() sets QSPI clock divider (0..7: ref_clk/2..ref_clk/256) and
+//    loopback clock delay (QSPI_LPBK_DLY_ADJ_REG image). Loopback clock is
+//    required for divider 0 (QSPI clock above 40 MHz).
+//
+//    calibrate() reads a block at progressively faster settings and keeps
+//    the fastest one whose data match the reference (given pattern or data
+//    read at the current, known good setting). For divider 0 the loopback
+//    delay window is scanned and the centre of the passing window is taken.
+//    The result is packed timing value which can be stored by the user's
+//    software and applied at later boots by set_timing() without calibration.
+//
+//    Flash Discovery
+//    ~~~~~~~~~~~~~~~
+//    init() in manual mode calls sfdp_probe() which reads JEDEC SFDP Basic
+//    Flash Parameter Table and sets up:
+//
+//        * read command: Quad I/O Read if supported, else Quad Output Read,
+//          else Fast Read; only the standard opcodes (0xEB, 0x6B) are accepted
+//          because the controller recognizes them to switch bus width;
+//        * mode and dummy cycles of the read commands (I/O and linear mode),
+//          continuous read is disabled if the flash has no mode clocks;
+//        * page size (JESD216A and later) and erase types used by erase_range();
+//        * device size, limited to 16 MB of 3-byte addressing; a non-zero
+//          'size' argument of init() takes precedence over SFDP density.
+//
+//    If SFDP is not supported, the defaults for S25FL-S family are kept. SFDP
+//    is not read in dual-parallel topology because the devices' responses are
+//    interleaved; in dual-stacked topology both devices are assumed to be of
+//    the same type.
+//
+//    Dual Flash Configurations
+//    ~~~~~~~~~~~~~~~~~~~~~~~~~
+//    init() accepts flash topology:
+//
+//        * topoDUAL_PARALLEL: two devices on 8-bit bus, each data byte is
+//          split between the devices, so bandwidth and capacity are doubled,
+//          logical page and erase block sizes are doubled as well. Command
+//          address is logical address / 2, so addresses and sizes of the
+//          user's data must be even;
+//
+//        * topoDUAL_STACKED: two devices on shared 4-bit bus with separate nCS
+//          lines, logical address space is the lower device followed by the
+//          upper one. In I/O mode the device is selected by LQSPI_CFG[U_PAGE],
+//          read() is split at the device boundary.
+//
+//    In both cases linear window covers 2*dev_size bytes.
+//
 class Qspi
 {
 public:
+    enum Topology : uint8_t
+    {
+        topoSINGLE,
+        topoDUAL_PARALLEL,
+        topoDUAL_STACKED
+    };
+
     Qspi() : cfg_reg(0)
+           , lq_cfg(0)
+           , bg_op(bgNONE)
+           , bg_lq_cfg(0)
+           , topo(topoSINGLE)
+           , upper(false)
+           , bg_upper(false)
+           , dev_size(LINEAR_SIZE)
+           , page_bytes(PAGE_SIZE*sizeof(uint32_t))
+           , rd_cmd(cmdQOR)
+           , lpbk_cfg(0)
+           , crc_val(0)
+           , crc_left(0)
     {
+        set_default_geometry();
     }
 
-    void init(bool manmode = true);
+    void init(bool manmode = true, const Topology topology = topoSINGLE, const uint32_t size = 0);  // size: 0 - SFDP/LINEAR_SIZE
 
     void cs_on()  { cfg_reg &= ~QSPI_PCS_MASK; wpa(QSPI_CONFIG_REG, cfg_reg); }
     void cs_off() { cfg_reg |=  QSPI_PCS_MASK; wpa(QSPI_CONFIG_REG, cfg_reg); }
@@ -85,6 +201,13 @@ public:
     void man_cs_disable() { cfg_reg |=  QSPI_MANUAL_CS_MASK;     wpa(QSPI_CONFIG_REG, cfg_reg); }
     void start_transfer() { cfg_reg |=  QSPI_MAN_START_COM_MASK; wpa(QSPI_CONFIG_REG, cfg_reg); }
 
+    static const uintptr_t LINEAR_ADDR = 0xfc000000;    // linear mode window
+    static const uint32_t  LINEAR_SIZE = 16*1024*1024;  // bytes, single device
+
+    Topology topology()  const { return topo; }
+    uint32_t page_size() const { return page_bytes; }
+    uint32_t capacity()  const { return topo == topoSINGLE ? dev_size : 2*dev_size; }
+
 
     enum CommandCode : uint8_t
     {
@@ -118,10 +241,19 @@ public:
         cmdDIOR      = 0xbb,
         cmdQIOR      = 0xeb,
 
+        cmdMBR       = 0xff,      // mode bit reset, exit continuous read
+        cmdRDSFDP    = 0x5a,      // read SFDP parameters
+
         // program flash array
         cmdPP        = 0x02,
         cmdQPP       = 0x32,
 
+        // suspend/resume
+        cmdPGSP      = 0x85,      // program suspend
+        cmdPGRS      = 0x8a,      // program resume
+        cmdERSP      = 0x75,      // erase suspend
+        cmdERRS      = 0x7a,      // erase resume
+
         // erase flash array
         cmdEB4K       = 0x20,     // erase block 4k
         cmdEB32K      = 0x52,     // erase block 32k
@@ -131,10 +263,19 @@ public:
 
     enum BufSize
     {
-        FIFO_SIZE = 63,           // words
-        PAGE_SIZE = 64            // words
+        FIFO_SIZE     = 63,       // words
+        PAGE_SIZE     = 64,       // words, single device
+        MAX_PAGE_SIZE = 256       // words, page buffers size
+    };
+
+    struct EraseType
+    {
+        uint32_t    size;         // bytes, single device
+        CommandCode cmd;
     };
 
+    static const uint32_t MAX_ERASE_TYPES = 4;
+
     enum StatusRegBitMask
     {
         SRWD  = 1ul << 7,
@@ -147,27 +288,137 @@ public:
         WIP   = 1ul << 0
     };
 
+    enum StatusReg2BitMask
+    {
+        ES    = 1ul << 1,         // erase suspended
+        PS    = 1ul << 0          // program suspended
+    };
+
 public:
     uint16_t read_id();
     uint8_t  read_sr1();
     uint8_t  read_sr2();
     void     write_sr2(uint8_t reg);
     uint8_t  wren();
+    void     clsr();
 
     uint32_t read (const uint32_t addr, void * const dst, uint32_t count);
-    void     write(const uint32_t addr, const void *data, const uint32_t count);
+    uint32_t read_crc(const uint32_t addr, void * const dst, const uint32_t count, uint32_t &crc);
+    bool     write(const uint32_t addr, const void *data, const uint32_t count);
     void     erase(const uint32_t addr, const CommandCode = cmdEB64K);
+    uint32_t erase_range(const uint32_t addr, const uint32_t count);
+    bool     is_blank(const uint32_t addr, const uint32_t count);
+
+    void     erase_start  (const uint32_t addr, const CommandCode = cmdEB64K);
+    bool     program_start(const uint32_t addr, const void *data, const uint32_t count);
+    bool     busy();
+    void     wait() { while( busy() ) { } }
+
+    void     set_read_cmd(const CommandCode cmd) { rd_cmd = cmd; }          // cmdQOR, cmdQIOR or cmdFAST_READ
+    CommandCode read_cmd_code() const { return rd_cmd; }
+
+    bool     sfdp_probe();
+    void     read_sfdp(const uint32_t addr, uint32_t *dst, const uint32_t count);
+    uint32_t erase_block_size(const CommandCode cmd) const;
+    uint32_t min_erase_size() const { return erase_tab[erase_count - 1].size*(topo == topoDUAL_PARALLEL ? 2 : 1); }
+    CommandCode min_erase_cmd() const { return erase_tab[erase_count - 1].cmd; }
+
+    void     set_clock (const uint32_t div, const uint32_t lpbk = 0);
+    uint32_t timing    () const;
+    bool     set_timing(const uint32_t t);
+    uint32_t calibrate (const uint32_t addr, uint32_t count, const void *pattern = 0);
+    void     linear_mode_on(const CommandCode cmd, const bool continuous = false);
+    void     linear_mode_on(const bool continuous = false) { linear_mode_on(rd_cmd, continuous); }
+    void     linear_mode_off();
+    bool     linear_mode() const { return lq_cfg & QSPI_LQ_MODE_MASK; }
+
+    const uint8_t *linear_window(const uint32_t addr = 0) const
+    {
+        return reinterpret_cast<const uint8_t *>(LINEAR_ADDR + addr);
+    }
+
+    //  DMA read from the linear window, linear mode must be on
+    bool read_dma(Dmac &dma, const uint32_t ch, const uint32_t addr, void *dst, const uint32_t count,
+                  Dmac::callback_t cb, void *ctx)
+    {
+        if(!linear_mode())
+            return false;
+
+        return dma.copy(ch, dst, linear_window(addr), count, cb, ctx);
+    }
+
+protected:
+    //--------------------------------------------------------------------------
+    //
+    //    Turns linear mode off for the object lifetime, used to wrap flash
+    //    modifying operations
+    //
+    class IoMode
+    {
+    public:
+        IoMode(Qspi &q) : qspi(q), lq_cfg(q.lq_cfg) { if(lq_cfg) qspi.linear_mode_off(); }
+       ~IoMode() { if(lq_cfg) qspi.set_lq_cfg(lq_cfg); }
+
+    private:
+        Qspi          &qspi;
+        const uint32_t lq_cfg;
+    };
+
+    void set_lq_cfg(const uint32_t cfg);
+
+    enum BackgroundOp : uint8_t
+    {
+        bgNONE,
+        bgERASE,
+        bgPROGRAM
+    };
+
+    uint32_t two_mem_cfg() const;
+    uint32_t dev_addr   (const uint32_t addr);
+    void     set_upper  (const bool u);
+
+    void start_bg   (const BackgroundOp op);
+    void complete_bg();
+    bool suspend    ();
+    void resume     ();
 
-private:
     INLINE bool wip() { return read_sr1() & WIP; }
-    void program_page  (const uint32_t addr, const uint32_t *data);
+    void erase_cmd     (const uint32_t addr, const CommandCode cmd);
+    void program       (const uint32_t addr, const uint8_t *data, const uint32_t count);
+    void program_cmd   (const uint32_t addr, const uint8_t *data, const uint32_t count);
+    void send_cmd      (const CommandCode cmd);
+    uint32_t read_io   (const uint32_t addr, void * const dst, uint32_t count);
+    uint32_t read_cmd  (const uint32_t addr);
+    uint32_t push_dummy(uint32_t count);
+    void     set_default_geometry();
+    void     set_clock_regs(const uint32_t div, const uint32_t lpbk);
+    bool     verify_read(const uint32_t addr, const uint32_t *ref, const uint32_t count);
     void fill_tx_fifo  (const uint32_t count, const uint32_t pattern = 0);
     void write_tx_fifo (const uint32_t *data, const uint32_t count);
+    uint32_t write_tx_bytes(const uint8_t *data, const uint32_t count, const uint32_t max_words);
     void read_rx_fifo  (uint8_t * const dst, const uint32_t count);
+    void read_rx_fifo_crc(uint8_t * const dst, const uint32_t count);
     void flush_rx_fifo ();
 
-private:
+protected:
     volatile  uint32_t cfg_reg;     // "cache" access to QSPI_CONFIG_REG
+              uint32_t lq_cfg;      // linear mode configuration, 0 in I/O mode
+    volatile  BackgroundOp bg_op;   // erase/program in progress
+              uint32_t bg_lq_cfg;   // linear mode to restore after background operation
+              Topology topo;
+              bool     upper;       // upper device selected, stacked topology
+              bool     bg_upper;    // device of background operation
+              uint32_t dev_size;    // bytes, single device
+              uint32_t page_bytes;  // logical page size
+              CommandCode rd_cmd;   // I/O mode read command
+              uint32_t lpbk_cfg;    // QSPI_LPBK_DLY_ADJ_REG image
+              uint8_t  qor_dummy;   // dummy bytes after address, cmdQOR/cmdFAST_READ
+              uint8_t  qior_dummy;  // dummy bytes after mode byte, cmdQIOR
+              bool     mode_bits;   // flash supports mode bits (continuous read)
+              uint8_t  erase_count;
+              EraseType erase_tab[MAX_ERASE_TYPES];  // largest first
+              uint32_t crc_val;     // CRC-32 register of read_crc()
+              uint32_t crc_left;    // bytes to be included in CRC, 0 if off
 };
 //------------------------------------------------------------------------------
 
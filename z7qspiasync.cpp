@@ -0,0 +1,296 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi QSPI Asynchronous Engine Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <string.h>
+#include <z7int.h>
+#include <z7qspiasync.h>
+
+//------------------------------------------------------------------------------
+//
+//    TX FIFO level at which program refill interrupt is raised, words
+//
+static const uint32_t TX_REFILL_LEVEL = 16;
+
+//------------------------------------------------------------------------------
+bool QspiAsync::submit(Request &req)
+{
+    if(linear_mode() || (!req.count && req.op != opERASE))
+        return false;
+
+    req.next = 0;
+
+    CritSect cs;
+
+    if(tail)
+    {
+        tail->next = &req;
+    }
+    else
+    {
+        head = &req;
+    }
+    tail = &req;
+
+    if(state == stIDLE)
+    {
+        start();
+    }
+
+    return true;
+}
+//------------------------------------------------------------------------------
+void QspiAsync::isr()
+{
+    switch(state)
+    {
+    case stREAD:
+    {
+        int_disable(QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK);
+
+        for( ; rx_skip; --rx_skip)
+        {
+            rpa(QSPI_RX_DATA_REG);     // drop command/address response
+        }
+
+        uint8_t        *dst  = head->buf + pos;
+        const uint32_t  FULL = len/sizeof(uint32_t);
+        const uint32_t  TAIL = len%sizeof(uint32_t);
+
+        read_rx_fifo(dst, FULL);
+        if(TAIL)
+        {
+            uint32_t val = rpa(QSPI_RX_DATA_REG);
+            memcpy(dst + FULL*sizeof(uint32_t), &val, TAIL);
+        }
+
+        pos += len;
+        if(pos < seg_end)
+        {
+            read_chunk();
+        }
+        else
+        {
+            cs_off();
+            if(pos < head->count)
+            {
+                start_read();               // the rest is on the upper device
+            }
+            else
+            {
+                complete(0);
+            }
+        }
+        break;
+    }
+    case stPROGRAM:
+        int_disable(QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK);
+        program_chunk();
+        break;
+
+    case stPROGRAM_DONE:
+        int_disable(QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK);
+        wpa(QSPI_TX_THRES_REG, 1);
+        cs_off();
+        flush_rx_fifo();
+        state = stWAIT_WIP;
+        break;
+
+    default:
+        int_disable(QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK | QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK);
+        break;
+    }
+}
+//------------------------------------------------------------------------------
+void QspiAsync::tick()
+{
+    if(state != stWAIT_WIP)
+        return;
+
+    const uint8_t sr     = read_sr1();
+    const uint8_t status = sr & (P_ERR | E_ERR);
+
+    if(status)
+    {
+        clsr();                        // flash keeps WIP set until errors cleared
+        complete(status);
+        return;
+    }
+
+    if(sr & WIP)
+        return;
+
+    if(head->op == opPROGRAM)
+    {
+        pos += len;
+        if(pos < head->count)
+        {
+            start_program();
+            return;
+        }
+    }
+    complete(0);
+}
+//------------------------------------------------------------------------------
+void QspiAsync::start()
+{
+    pos = 0;
+    switch(head->op)
+    {
+    case opREAD:    start_read();    break;
+    case opPROGRAM: start_program(); break;
+    case opERASE:   start_erase();   break;
+    }
+}
+//------------------------------------------------------------------------------
+void QspiAsync::complete(const uint8_t status)
+{
+    Request *req = head;
+
+    req->status = status;
+    head        = req->next;
+    if(head)
+    {
+        start();
+    }
+    else
+    {
+        tail  = 0;
+        state = stIDLE;
+    }
+
+    if(req->callback)
+    {
+        req->callback(*req);
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    In dual stacked configuration a read crossing the device boundary is
+//    split: one read command per device
+//
+void QspiAsync::start_read()
+{
+    const uint32_t ADDR     = head->addr + pos;
+    const uint32_t DEV_ADDR = dev_addr(ADDR);
+
+    state   = stREAD;
+    seg_end = head->count;
+    if(topo == topoDUAL_STACKED && ADDR < dev_size && head->addr + head->count > dev_size)
+    {
+        seg_end = dev_size - head->addr;
+    }
+
+    cs_on();
+    rx_skip = read_cmd(DEV_ADDR);
+
+    read_chunk();
+}
+//------------------------------------------------------------------------------
+void QspiAsync::read_chunk()
+{
+    const uint32_t ROOM = FIFO_SIZE - rx_skip;
+    const uint32_t REST = seg_end - pos;
+
+    uint32_t words = REST/sizeof(uint32_t) + (REST%sizeof(uint32_t) ? 1 : 0);
+    if(words > ROOM)
+    {
+        words = ROOM;
+    }
+    len = words*sizeof(uint32_t) < REST ? words*sizeof(uint32_t) : REST;
+
+    fill_tx_fifo(words);
+    wpa(QSPI_RX_THRES_REG, words + rx_skip);
+    start_transfer();
+
+    int_enable(QSPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK);
+}
+//------------------------------------------------------------------------------
+void QspiAsync::start_program()
+{
+    const uint32_t PAGE_BYTES = page_size();
+    const uint32_t ADDR       = head->addr + pos;
+
+    len  = PAGE_BYTES - ADDR%PAGE_BYTES;                  // up to the page end
+    if(len > head->count - pos)
+    {
+        len = head->count - pos;
+    }
+    txed  = 0;
+    state = stPROGRAM;
+
+    uint32_t rev_addr = __builtin_bswap32( dev_addr(ADDR) ) >> 8;
+
+    wren();
+    cs_on();
+    wpa(QSPI_TXD0_REG,  cmdQPP + ( rev_addr << 8) );
+
+    push_data(FIFO_SIZE - 1);
+    start_transfer();
+    wpa(QSPI_TX_THRES_REG, txed < len ? TX_REFILL_LEVEL : 1);
+    if(txed == len)
+    {
+        state = stPROGRAM_DONE;
+    }
+    int_enable(QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK);
+}
+//------------------------------------------------------------------------------
+void QspiAsync::program_chunk()
+{
+    flush_rx_fifo();
+    push_data(FIFO_SIZE - TX_REFILL_LEVEL);
+    start_transfer();
+
+    if(txed == len)
+    {
+        wpa(QSPI_TX_THRES_REG, 1);     // raise interrupt when FIFO becomes empty
+        state = stPROGRAM_DONE;
+    }
+    int_enable(QSPI_INT_STS_TX_FIFO_NOT_FULL_MASK);
+}
+//------------------------------------------------------------------------------
+void QspiAsync::start_erase()
+{
+    erase_cmd(head->addr, head->cmd);
+    state = stWAIT_WIP;
+}
+//------------------------------------------------------------------------------
+//
+//    Pushes up to 'count' words of current page to TX FIFO, returns number
+//    of bytes pushed
+//
+uint32_t QspiAsync::push_data(const uint32_t count)
+{
+    const uint32_t n = write_tx_bytes(head->buf + pos + txed, len - txed, count);
+
+    txed += n;
+    return n;
+}
+//------------------------------------------------------------------------------
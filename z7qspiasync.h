@@ -0,0 +1,151 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi QSPI Asynchronous Engine Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7QSPIASYNC_H
+#define PS7QSPIASYNC_H
+
+#include "z7qspi.h"
+
+//------------------------------------------------------------------------------
+//
+//    Interrupt-driven Quad-SPI engine
+//
+//    Notes:
+//    ~~~~~
+//    The engine executes queued read/program/erase requests in background.
+//    FIFO service is driven by QSPI interrupt (PS7IRQ_ID_QSPI):
+//
+//        * read:    RX FIFO is drained and TX FIFO is refilled with dummy words
+//                   at QSPI_RX_THRES_REG level;
+//        * program: TX FIFO is refilled at QSPI_TX_THRES_REG level;
+//
+//    Completion of flash internal operation (page program, erase) is checked
+//    by tick() which must be called periodically by the user's software, say,
+//    from a timer ISR. tick() issues short status register read only when an
+//    operation is in progress, so CPU is free while flash is busy.
+//
+//    Request objects are owned by the user's software and must stay alive
+//    until completion callback is invoked. Callback is called from interrupt
+//    context (isr() or tick()).
+//
+//    isr() and tick() must not preempt each other: both interrupts should have
+//    the same priority or nested interrupts must be disabled.
+//
+//    The engine works in I/O mode only, submit() rejects requests while linear
+//    mode is on.
+//
+//    Usage example:
+//
+//        QspiAsync qspi;
+//
+//        void qspi_isr()  { qspi.isr();  }
+//        void timer_isr() { qspi.tick(); ... }
+//        ...
+//        ps7_register_isr(qspi_isr, PS7IRQ_ID_QSPI);
+//        gic_int_enable(PS7IRQ_ID_QSPI);
+//
+class QspiAsync : public Qspi
+{
+public:
+    enum Operation : uint8_t
+    {
+        opREAD,
+        opPROGRAM,
+        opERASE
+    };
+
+    struct Request;
+    typedef void (*callback_t)(Request &req);
+
+    struct Request
+    {
+        Operation    op;
+        CommandCode  cmd;         // erase command for opERASE
+        uint8_t      status;      // flash SR1 error bits (P_ERR/E_ERR) on completion
+        uint32_t     addr;
+        uint8_t     *buf;         // destination for opREAD, source for opPROGRAM
+        uint32_t     count;       // bytes
+        callback_t   callback;
+        void        *ctx;         // user's data
+        Request     *next;        // queue link, used by the engine
+    };
+
+public:
+    QspiAsync() : Qspi()
+                , head(0)
+                , tail(0)
+                , state(stIDLE)
+    {
+    }
+
+    bool submit(Request &req);
+    bool idle() const { return state == stIDLE; }
+
+    void isr();
+    void tick();
+
+private:
+    enum State : uint8_t
+    {
+        stIDLE,
+        stREAD,
+        stPROGRAM,
+        stPROGRAM_DONE,
+        stWAIT_WIP
+    };
+
+    void start();
+    void complete(const uint8_t status);
+
+    void     start_read();
+    void     read_chunk();
+    void     start_program();
+    void     program_chunk();
+    void     start_erase();
+    uint32_t push_data(const uint32_t count);
+
+    INLINE void int_enable (const uint32_t mask) { wpa(QSPI_INT_EN_REG,  mask); }
+    INLINE void int_disable(const uint32_t mask) { wpa(QSPI_INT_DIS_REG, mask); }
+
+private:
+    Request * volatile head;
+    Request * volatile tail;
+    volatile State     state;
+
+    uint32_t           pos;        // bytes of current request done
+    uint32_t           len;        // bytes of current chunk (read)/page (program)
+    uint32_t           txed;       // bytes of current page pushed to TX FIFO
+    uint32_t           rx_skip;    // command/address response words to drop
+    uint32_t           seg_end;    // request offset where current read command ends
+};
+//------------------------------------------------------------------------------
+
+#endif  // PS7QSPIASYNC_H
@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi QSPI Sector Cache Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <string.h>
+#include <z7qspicache.h>
+
+//------------------------------------------------------------------------------
+QspiCache::QspiCache(Qspi &q, void *buf, const uint32_t size)
+    : qspi(q)
+    , line_desc(reinterpret_cast<Line *>(buf))
+    , line_count(size/(LINE_SIZE + sizeof(Line)))
+    , clock(0)
+    , hit_count(0)
+    , miss_count(0)
+{
+    line_data = reinterpret_cast<uint8_t *>(buf) + line_count*sizeof(Line);
+    invalidate_all();
+}
+//------------------------------------------------------------------------------
+uint32_t QspiCache::read(const uint32_t addr, void *dst, const uint32_t count)
+{
+    uint8_t *p = reinterpret_cast<uint8_t *>(dst);
+
+    if(!line_count)
+        return qspi.read(addr, dst, count);
+
+    for(uint32_t done = 0; done < count; )
+    {
+        const uint32_t ADDR   = addr + done;
+        const uint32_t OFFSET = ADDR % LINE_SIZE;
+        uint32_t       len    = LINE_SIZE - OFFSET;
+        if(len > count - done)
+        {
+            len = count - done;
+        }
+
+        const uint8_t *line = lookup(ADDR - OFFSET);
+        memcpy(p + done, line + OFFSET, len);
+        done += len;
+    }
+
+    return count;
+}
+//------------------------------------------------------------------------------
+bool QspiCache::write(const uint32_t addr, const void *data, const uint32_t count)
+{
+    const bool res = qspi.write(addr, data, count);
+
+    if(res)
+    {
+        update(addr, reinterpret_cast<const uint8_t *>(data), count);
+    }
+    else
+    {
+        invalidate(addr, count);
+    }
+
+    return res;
+}
+//------------------------------------------------------------------------------
+void QspiCache::erase(const uint32_t addr, const Qspi::CommandCode cmd)
+{
+    const uint32_t SIZE = qspi.erase_block_size(cmd);
+
+    qspi.erase(addr, cmd);
+    if(SIZE)
+    {
+        invalidate(addr & ~(SIZE - 1), SIZE);
+    }
+    else
+    {
+        invalidate_all();
+    }
+}
+//------------------------------------------------------------------------------
+uint32_t QspiCache::erase_range(const uint32_t addr, const uint32_t count)
+{
+    const uint32_t MIN_SIZE = qspi.min_erase_size();
+    const uint32_t START    = addr & ~(MIN_SIZE - 1);
+    const uint32_t END      = (addr + count + MIN_SIZE - 1) & ~(MIN_SIZE - 1);
+
+    const uint32_t res = qspi.erase_range(addr, count);
+    invalidate(START, END - START);
+
+    return res;
+}
+//------------------------------------------------------------------------------
+void QspiCache::invalidate(const uint32_t addr, const uint32_t count)
+{
+    const uint32_t START = addr & ~(LINE_SIZE - 1);
+
+    for(uint32_t i = 0; i < line_count; ++i)
+    {
+        const uint32_t TAG = line_desc[i].tag;
+        if(TAG != INVALID_TAG && TAG >= START && TAG < addr + count)
+        {
+            line_desc[i].tag   = INVALID_TAG;
+            line_desc[i].stamp = 0;
+        }
+    }
+}
+//------------------------------------------------------------------------------
+void QspiCache::invalidate_all()
+{
+    for(uint32_t i = 0; i < line_count; ++i)
+    {
+        line_desc[i].tag   = INVALID_TAG;
+        line_desc[i].stamp = 0;
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Returns pointer to cached copy of the line, loads the line on miss.
+//    Empty lines have zero stamp, so they are taken before any valid line
+//
+uint8_t *QspiCache::lookup(const uint32_t tag)
+{
+    uint32_t victim = 0;
+
+    if(++clock == 0)                      // time base wrapped, restart LRU history
+    {
+        for(uint32_t i = 0; i < line_count; ++i)
+        {
+            line_desc[i].stamp = line_desc[i].tag == INVALID_TAG ? 0 : 1;
+        }
+        clock = 2;
+    }
+
+    for(uint32_t i = 0; i < line_count; ++i)
+    {
+        if(line_desc[i].tag == tag)
+        {
+            ++hit_count;
+            line_desc[i].stamp = clock;
+            return data(i);
+        }
+        if(line_desc[i].stamp < line_desc[victim].stamp)
+        {
+            victim = i;
+        }
+    }
+
+    ++miss_count;
+    uint8_t *line = data(victim);
+    line_desc[victim].tag   = INVALID_TAG;    // keep the line empty if read is interrupted
+    qspi.read(tag, line, LINE_SIZE);
+    line_desc[victim].tag   = tag;
+    line_desc[victim].stamp = clock;
+
+    return line;
+}
+//------------------------------------------------------------------------------
+void QspiCache::update(const uint32_t addr, const uint8_t *src, const uint32_t count)
+{
+    for(uint32_t i = 0; i < line_count; ++i)
+    {
+        const uint32_t TAG = line_desc[i].tag;
+        if(TAG == INVALID_TAG || TAG + LINE_SIZE <= addr || TAG >= addr + count)
+            continue;
+
+        const uint32_t START = TAG > addr ? TAG : addr;
+        const uint32_t END   = TAG + LINE_SIZE < addr + count ? TAG + LINE_SIZE : addr + count;
+
+        memcpy(data(i) + (START - TAG), src + (START - addr), END - START);
+    }
+}
+//------------------------------------------------------------------------------
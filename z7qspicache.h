@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi QSPI Sector Cache Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7QSPICACHE_H
+#define PS7QSPICACHE_H
+
+#include "z7qspi.h"
+
+//------------------------------------------------------------------------------
+//
+//    Flash sector cache
+//
+//    Notes:
+//    ~~~~~
+//    The cache keeps copies of 4K flash sectors (lines) in a RAM buffer
+//    supplied by the user's software, the buffer can be placed in OCM or DDR.
+//    Line descriptors are placed at the buffer beginning, the rest is split
+//    into lines, so the buffer of N*(LINE_SIZE + 8) bytes holds N lines.
+//
+//    read() serves cached lines by memcpy, missed lines are loaded from flash
+//    as a whole, the least recently used line is evicted.
+//
+//    write() is write-through: flash is written and cached copies of the
+//    touched lines are updated; if Qspi::write() fails (0->1 transitions),
+//    the lines are invalidated since flash content is partially updated.
+//    erase() and erase_range() invalidate the touched lines.
+//
+//    Flash modified bypassing the cache (directly by Qspi or QspiAsync) must
+//    be followed by invalidate() call for the modified range.
+//
+//    Usage example:
+//
+//        Qspi qspi;
+//        __attribute__((section(".ocm"))) uint8_t cache_buf[8*(QspiCache::LINE_SIZE + 8)];
+//        QspiCache cache(qspi, cache_buf, sizeof(cache_buf));
+//
+class QspiCache
+{
+public:
+    static const uint32_t LINE_SIZE = 4096;
+
+public:
+    QspiCache(Qspi &q, void *buf, const uint32_t size);
+
+    uint32_t read (const uint32_t addr, void *dst, const uint32_t count);
+    bool     write(const uint32_t addr, const void *data, const uint32_t count);
+    void     erase(const uint32_t addr, const Qspi::CommandCode cmd = Qspi::cmdEB64K);
+    uint32_t erase_range(const uint32_t addr, const uint32_t count);
+
+    void     invalidate(const uint32_t addr, const uint32_t count);
+    void     invalidate_all();
+
+    uint32_t lines () const { return line_count; }
+    uint32_t hits  () const { return hit_count;  }
+    uint32_t misses() const { return miss_count; }
+    void     reset_stats()  { hit_count = 0; miss_count = 0; }
+
+private:
+    struct Line
+    {
+        uint32_t tag;        // flash address of the line, INVALID_TAG if empty
+        uint32_t stamp;      // last access time for LRU
+    };
+
+    static const uint32_t INVALID_TAG = 0xffffffff;
+
+    uint8_t *lookup(const uint32_t tag);
+    uint8_t *data  (const uint32_t idx) const { return line_data + idx*LINE_SIZE; }
+
+    void     update(const uint32_t addr, const uint8_t *src, const uint32_t count);
+
+private:
+    Qspi     &qspi;
+    Line     *line_desc;
+    uint8_t  *line_data;
+    uint32_t  line_count;
+    uint32_t  clock;        // access counter, LRU time base
+
+    uint32_t  hit_count;
+    uint32_t  miss_count;
+};
+//------------------------------------------------------------------------------
+
+#endif  // PS7QSPICACHE_H
@@ -0,0 +1,137 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi Lock-free Ring Buffer Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7RING_H
+#define PS7RING_H
+
+#include <stdint.h>
+#include <z7common.h>
+
+//------------------------------------------------------------------------------
+//
+//    Single-producer/single-consumer ring buffer
+//
+//    Notes:
+//    ~~~~~
+//    Producer changes 'head' only, consumer changes 'tail' only, so the
+//    buffer needs no locking when the producer and the consumer are thread
+//    and ISR (or two CPUs). Indices run freely and are wrapped by mask, SIZE
+//    must be a power of two; the buffer holds up to SIZE items.
+//
+//    Data barrier orders item accesses against index update, so the other
+//    side never sees an index ahead of the data.
+//
+template<typename T, uint32_t SIZE>
+class RingBuffer
+{
+    static_assert(SIZE && (SIZE & (SIZE - 1)) == 0, "RingBuffer size must be a power of two");
+
+public:
+    RingBuffer() : head(0), tail(0) { }
+
+    uint32_t count() const { return head - tail; }
+    uint32_t free () const { return SIZE - count(); }
+    bool     empty() const { return head == tail; }
+    bool     full () const { return count() == SIZE; }
+
+    //  producer side
+    bool push(const T &item)
+    {
+        const uint32_t HEAD = head;
+        if(HEAD - tail == SIZE)
+            return false;
+
+        buf[HEAD & MASK] = item;
+        barrier();
+        head = HEAD + 1;
+        return true;
+    }
+
+    uint32_t write(const T *src, const uint32_t n)
+    {
+        const uint32_t HEAD  = head;
+        const uint32_t AVAIL = SIZE - (HEAD - tail);
+        const uint32_t COUNT = n < AVAIL ? n : AVAIL;
+
+        for(uint32_t i = 0; i < COUNT; ++i)
+        {
+            buf[(HEAD + i) & MASK] = src[i];
+        }
+        barrier();
+        head = HEAD + COUNT;
+        return COUNT;
+    }
+
+    //  consumer side
+    bool pop(T &item)
+    {
+        const uint32_t TAIL = tail;
+        if(head == TAIL)
+            return false;
+
+        barrier();
+        item = buf[TAIL & MASK];
+        barrier();
+        tail = TAIL + 1;
+        return true;
+    }
+
+    uint32_t read(T *dst, const uint32_t n)
+    {
+        const uint32_t TAIL  = tail;
+        const uint32_t AVAIL = head - TAIL;
+        const uint32_t COUNT = n < AVAIL ? n : AVAIL;
+
+        barrier();
+        for(uint32_t i = 0; i < COUNT; ++i)
+        {
+            dst[i] = buf[(TAIL + i) & MASK];
+        }
+        barrier();
+        tail = TAIL + COUNT;
+        return COUNT;
+    }
+
+    void clear() { tail = head; }     // consumer side
+
+private:
+    static const uint32_t MASK = SIZE - 1;
+
+    INLINE static void barrier() { __asm__ __volatile__ ("    dmb" : : : "memory"); }
+
+private:
+    T                 buf[SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+};
+//------------------------------------------------------------------------------
+
+#endif // PS7RING_H
@@ -35,6 +35,7 @@
 #include <stdint.h>
 #include <ps7mmrs.h>
 #include <z7common.h>
+#include <z7dmac.h>
 
 //------------------------------------------------------------------------------
 class Spi
@@ -61,10 +62,17 @@ public:
     Spi(const uintptr_t addr)
            : regs( reinterpret_cast<Regs*>(addr) )
            , busy(false)
+           , dma(0)
+           , dma_ch(0)
     { 
-        const uint32_t RST_MASK = addr == SPI0_ADDR ? SPI0_RST_MASK : SPI1_RST_MASK;
+        reset();
+    }
+
+    // SPI controller reset: registers to defaults, FIFOs and shifter cleared
+    void reset()
+    {
+        const uint32_t RST_MASK = reinterpret_cast<uintptr_t>(regs) == SPI0_ADDR ? SPI0_RST_MASK : SPI1_RST_MASK;
 
-        // SPI controller reset and clocks
         slcr_unlock();
         sbpa(SPI_RST_CTRL_REG, RST_MASK);
         cbpa(SPI_RST_CTRL_REG, RST_MASK);
@@ -82,13 +90,55 @@ public:
         regs->CONFIG_REG |= SPI_MAN_START_COM_MASK;
     }
 
+    //--------------------------------------------------------------------------
+    //
+    //    DMA transmit: DMA controller moves data to TX FIFO by DMA_CHUNK bytes,
+    //    each chunk is started from SPI ISR by dma_tx_isr() when TX FIFO level
+    //    drops below DMA_CHUNK. Received data is not collected; controller is
+    //    expected to be in auto start mode
+    //
+    bool write_dma(Dmac &d, const uint32_t ch, const void *src, const uint32_t count,
+                   Dmac::callback_t cb, void *ctx)
+    {
+        if(!d.to_fifo(ch, &regs->TX_DATA_REG, src, count, DMA_CHUNK, dma_tx_pace, this, cb, ctx))
+            return false;
+
+        dma    = &d;
+        dma_ch = ch;
+        regs->TX_THRES_REG = DMA_CHUNK;
+        regs->INT_EN_REG   = SPI_INT_STS_TX_FIFO_NOT_FULL_MASK;
+        return true;
+    }
+
+    // to be called from SPI ISR, returns true if TX FIFO event is consumed
+    bool dma_tx_isr()
+    {
+        if(!dma || !dma->busy(dma_ch) || !(regs->INT_STS_REG & SPI_INT_STS_TX_FIFO_NOT_FULL_MASK))
+            return false;
+
+        regs->INT_DIS_REG = SPI_INT_STS_TX_FIFO_NOT_FULL_MASK;
+        dma->kick(dma_ch);
+        return true;
+    }
+
+    static const uint32_t FIFO_SIZE = 128;
+    static const uint32_t DMA_CHUNK = FIFO_SIZE/2;
+
 protected:
+    static void dma_tx_pace(void *p)
+    {
+        static_cast<Spi *>(p)->regs->INT_EN_REG = SPI_INT_STS_TX_FIFO_NOT_FULL_MASK;
+    }
+
+
     static const uint32_t SPI0_RST_MASK = SPI_RST_CTRL_SPI0_REF_RST_MASK | SPI_RST_CTRL_SPI0_CPU1X_RST_MASK;
     static const uint32_t SPI1_RST_MASK = SPI_RST_CTRL_SPI1_REF_RST_MASK | SPI_RST_CTRL_SPI1_CPU1X_RST_MASK;
         
 protected:
     volatile Regs  *regs;
     volatile bool   busy;
+    Dmac           *dma;
+    uint32_t        dma_ch;
 };
 //------------------------------------------------------------------------------
 
@@ -0,0 +1,291 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi SPI Master Engine Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <z7int.h>
+#include <z7spimaster.h>
+
+//------------------------------------------------------------------------------
+void SpiMaster::init(const Mode mode, const uint32_t div)
+{
+    regs->EN_REG      = 0;
+    regs->INT_DIS_REG = 0xffffffff;
+
+    def_cfg = config(mode, div);
+    cfg_reg = def_cfg;
+    dly_reg = 0;
+    cur_dev = 0;
+    batch   = 0;
+
+    regs->CONFIG_REG   = cfg_reg;
+    regs->DELAY_REG    = dly_reg;
+    regs->TX_THRES_REG = 1;
+    regs->RX_THRES_REG = 1;
+    regs->INT_STS_REG  = SPI_INT_STS_RX_OVERFLOW_MASK | SPI_INT_STS_MODE_FAIL_MASK | SPI_INT_STS_TX_FIFO_UNDERFLOW_MASK;
+    regs->EN_REG       = 1;
+}
+//------------------------------------------------------------------------------
+bool SpiMaster::submit(Transfer &xfer)
+{
+    if(!xfer.count || (!xfer.dev && xfer.cs > 2))
+        return false;
+
+    const uint32_t PRIO = xfer.dev ? xfer.dev->priority() : prNORMAL;
+
+    xfer.next = 0;
+
+    CritSect cs;
+
+    if(qtail[PRIO])
+    {
+        qtail[PRIO]->next = &xfer;
+    }
+    else
+    {
+        qhead[PRIO] = &xfer;
+    }
+    qtail[PRIO] = &xfer;
+
+    if(!cur)
+    {
+        cur = next_transfer();
+        start();
+    }
+
+    return true;
+}
+//------------------------------------------------------------------------------
+void SpiMaster::isr()
+{
+    const uint32_t STS = regs->INT_STS_REG;
+
+    if(!cur)
+    {
+        regs->INT_DIS_REG = 0xffffffff;
+        return;
+    }
+
+    if(STS & (SPI_INT_STS_MODE_FAIL_MASK | SPI_INT_STS_RX_OVERFLOW_MASK))
+    {
+        //  up to FIFO_SIZE bytes of the aborted transfer may still be in TX
+        //  FIFO and would be clocked out under the next transfer's nCS, so
+        //  the controller is reset (it clears both FIFOs) and set up again
+        regs->INT_DIS_REG = 0xffffffff;
+        reset();
+        regs->CONFIG_REG   = cfg_reg | SPI_CS_MASK;
+        regs->DELAY_REG    = dly_reg;
+        regs->TX_THRES_REG = 1;
+        regs->RX_THRES_REG = 1;
+        regs->EN_REG       = 1;
+        complete(STS & SPI_INT_STS_MODE_FAIL_MASK ? stsMODE_FAIL : stsOVERFLOW);
+        return;
+    }
+
+    if( !(STS & SPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) )
+        return;
+
+    //  RX FIFO holds at least 'thres' bytes
+    const uint32_t N  = thres;
+    uint8_t       *rx = cur->rx;
+    if(rx)
+    {
+        rx += rxed;
+        for(uint32_t i = 0; i < N; ++i)
+        {
+            rx[i] = regs->RX_DATA_REG;
+        }
+    }
+    else
+    {
+        for(uint32_t i = 0; i < N; ++i)
+        {
+            regs->RX_DATA_REG;
+        }
+    }
+    rxed += N;
+
+    if(rxed == cur->count)
+    {
+        regs->INT_DIS_REG = SPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK | SPI_INT_STS_MODE_FAIL_MASK | SPI_INT_STS_RX_OVERFLOW_MASK;
+        complete(stsOK);
+        return;
+    }
+
+    push(N);
+
+    const uint32_t REST = cur->count - rxed;
+    thres = REST < CHUNK ? REST : CHUNK;
+    regs->RX_THRES_REG = thres;
+}
+//------------------------------------------------------------------------------
+void SpiMaster::start()
+{
+    if(!cur)
+        return;
+
+    txed = 0;
+    rxed = 0;
+
+    select(*cur);
+
+    thres = cur->count < CHUNK ? cur->count : CHUNK;
+    regs->RX_THRES_REG = thres;
+
+    push(FIFO_SIZE);
+    regs->INT_EN_REG = SPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK | SPI_INT_STS_MODE_FAIL_MASK | SPI_INT_STS_RX_OVERFLOW_MASK;
+}
+//------------------------------------------------------------------------------
+void SpiMaster::complete(const uint8_t status)
+{
+    Transfer *xfer = cur;
+
+    deselect();
+
+    xfer->status = status;
+    cur          = next_transfer();
+    start();
+
+    if(xfer->callback)
+    {
+        xfer->callback(*xfer);
+    }
+}
+//------------------------------------------------------------------------------
+//
+//    Takes the next transfer out of the queues: the highest priority class,
+//    the current device first while the batch limit is not reached
+//
+SpiMaster::Transfer *SpiMaster::next_transfer()
+{
+    for(uint32_t p = 0; p < PRIORITY_COUNT; ++p)
+    {
+        Transfer *xfer = qhead[p];
+        if(!xfer)
+            continue;
+
+        Transfer *prev = 0;
+        if(batch < MAX_BATCH)
+        {
+            for(Transfer *t = xfer; t; prev = t, t = t->next)
+            {
+                if(t->dev == cur_dev)
+                {
+                    xfer = t;
+                    break;
+                }
+            }
+            if(xfer->dev != cur_dev)
+            {
+                prev = 0;
+            }
+        }
+
+        if(prev)
+        {
+            prev->next = xfer->next;
+        }
+        else
+        {
+            qhead[p] = xfer->next;
+        }
+        if(qtail[p] == xfer)
+        {
+            qtail[p] = prev;
+        }
+        return xfer;
+    }
+    return 0;
+}
+//------------------------------------------------------------------------------
+void SpiMaster::push(uint32_t n)
+{
+    const uint32_t REST = cur->count - txed;
+    if(n > REST)
+    {
+        n = REST;
+    }
+
+    const uint8_t *tx = cur->tx;
+    if(tx)
+    {
+        tx += txed;
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            regs->TX_DATA_REG = tx[i];
+        }
+    }
+    else
+    {
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            regs->TX_DATA_REG = 0xff;
+        }
+    }
+    txed += n;
+}
+//------------------------------------------------------------------------------
+//
+//    Clock mode and delays are changed with nCS deasserted, then nCS is
+//    asserted; for the same device only nCS is asserted
+//
+void SpiMaster::select(const Transfer &xfer)
+{
+    const SpiDevice *dev = xfer.dev;
+
+    if(dev != cur_dev)
+    {
+        cur_dev = dev;
+        batch   = 0;
+
+        const uint32_t CFG = dev ? dev->config() : def_cfg;
+        const uint32_t DLY = dev ? dev->delay()  : 0;
+
+        regs->CONFIG_REG = CFG | SPI_CS_MASK;       // new clock mode, nCS deasserted
+        if(DLY != dly_reg)
+        {
+            dly_reg         = DLY;
+            regs->DELAY_REG = DLY;
+        }
+        cfg_reg = CFG;
+    }
+    ++batch;
+
+    if(!dev)
+    {
+        cfg_reg = (def_cfg & ~SPI_CS_MASK) | (cs_bits(xfer.cs) << SPI_CS_BPOS);
+    }
+    regs->CONFIG_REG = cfg_reg;
+}
+//------------------------------------------------------------------------------
+void SpiMaster::deselect()
+{
+    regs->CONFIG_REG = cfg_reg | SPI_CS_MASK;
+}
+//------------------------------------------------------------------------------
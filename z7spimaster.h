@@ -0,0 +1,226 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi SPI Master Engine Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7SPIMASTER_H
+#define PS7SPIMASTER_H
+
+#include "z7spi.h"
+
+//------------------------------------------------------------------------------
+//
+//    Interrupt-driven SPI master
+//
+//    Notes:
+//    ~~~~~
+//    The engine executes queued full-duplex transfers of any length. Chip
+//    select is driven manually (held for the whole transfer), transmission
+//    starts automatically as soon as TX FIFO is not empty.
+//
+//    TX FIFO is filled in bursts: the transfer starts with up to FIFO_SIZE
+//    bytes in flight, RX threshold is set to CHUNK bytes; the ISR reads
+//    exactly the threshold number of bytes (no FIFO status polling) and
+//    pushes the same number of new bytes, so up to FIFO_SIZE bytes are in
+//    flight and RX FIFO can not overflow. SPI clock keeps running while the
+//    ISR latency is below CHUNK byte times.
+//
+//    'tx' of the transfer can be null (0xff is sent), 'rx' can be null
+//    (received data are dropped). Transfer objects are owned by the user's
+//    software and must stay alive until completion callback is invoked.
+//    Callback is called from interrupt context.
+//
+//    Devices
+//    ~~~~~~~
+//    Several chips with different clock mode, divider, delays and chip select
+//    can share the controller: a transfer refers to SpiDevice which keeps
+//    CONFIG_REG and DELAY_REG images. Full configuration is written only when
+//    the transfer targets a device other than the previous one, otherwise
+//    only chip select is asserted. Transfers without device use the
+//    configuration given to init() and chip select 'cs'.
+//
+//    Transfers are queued by the device priority class, the next transfer
+//    is taken from the highest non-empty class (strict priority: a busy high
+//    priority device can starve lower ones). Within the class transfers to
+//    the current device are taken first - up to MAX_BATCH in a row - so
+//    reconfigurations are rare; the order of transfers of each device is
+//    kept.
+//
+//    Usage example:
+//
+//        SpiMaster spi(SPI0_ADDR);
+//        SpiDevice adc(0, SpiMaster::MODE1, 2, SpiMaster::prHIGH);
+//        SpiDevice dac(1, SpiMaster::MODE0, 3);
+//
+//        void spi0_isr() { spi.isr(); }
+//        ...
+//        spi.init(SpiMaster::MODE0, 3);          // ref_clk/16
+//        ps7_register_isr(spi0_isr, PS7IRQ_ID_SPI0);
+//        gic_int_enable(PS7IRQ_ID_SPI0);
+//        ...
+//        xfer.dev = &adc;
+//        spi.submit(xfer);
+//
+class SpiDevice;
+
+class SpiMaster : public Spi
+{
+public:
+    enum Mode : uint8_t              // CPOL/CPHA
+    {
+        MODE0 = 0,
+        MODE1 = 1,
+        MODE2 = 2,
+        MODE3 = 3
+    };
+
+    enum Priority : uint8_t
+    {
+        prHIGH,
+        prNORMAL,
+        prLOW,
+        PRIORITY_COUNT
+    };
+
+    enum Status : uint8_t
+    {
+        stsOK,
+        stsMODE_FAIL,
+        stsOVERFLOW
+    };
+
+    struct Transfer;
+    typedef void (*callback_t)(Transfer &xfer);
+
+    struct Transfer
+    {
+        const SpiDevice *dev;        // 0: init() configuration and 'cs'
+        uint8_t          cs;         // slave select 0..2, if no device
+        uint8_t          status;     // Status on completion
+        const uint8_t   *tx;
+        uint8_t         *rx;
+        uint32_t         count;      // bytes
+        callback_t       callback;
+        void            *ctx;        // user's data
+        Transfer        *next;       // queue link, used by the engine
+    };
+
+    static const uint32_t CHUNK     = FIFO_SIZE/2;
+    static const uint32_t CS_NONE   = 0xf;
+    static const uint32_t MAX_BATCH = 8;
+
+public:
+    SpiMaster(const uintptr_t addr) : Spi(addr)
+                                    , cur(0)
+                                    , cfg_reg(0)
+                                    , def_cfg(0)
+                                    , dly_reg(0)
+                                    , cur_dev(0)
+                                    , batch(0)
+    {
+        for(uint32_t i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            qhead[i] = 0;
+            qtail[i] = 0;
+        }
+    }
+
+    void init(const Mode mode, const uint32_t div);   // div: 1..7, ref_clk/4..ref_clk/256
+
+    bool submit(Transfer &xfer);
+    bool idle() const { return !cur; }
+
+    void isr();
+
+    //  CONFIG_REG image: master, manual nCS, nCS deasserted
+    static constexpr uint32_t config(const Mode mode, const uint32_t div)
+    {
+        return SPI_MODE_SEL_MASK                                         +
+               SPI_MANUAL_CS_MASK                                        +
+               SPI_MODEFAIL_GEN_EN_MASK                                  +
+              (CS_NONE << SPI_CS_BPOS)                                   +
+              ((div << SPI_BAUD_RATE_DIV_BPOS) & SPI_BAUD_RATE_DIV_MASK) +
+              (mode & 2 ? SPI_CLK_POL_MASK : 0)                          +
+              (mode & 1 ? SPI_CLK_PH_MASK  : 0);
+    }
+
+protected:
+    void      start();
+    void      complete(const uint8_t status);
+    Transfer *next_transfer();
+    void      push(uint32_t n);
+    void      select(const Transfer &xfer);
+    void      deselect();
+
+    INLINE static uint32_t cs_bits(const uint32_t cs) { return ~(1ul << cs) & CS_NONE; }
+
+protected:
+    Transfer * volatile qhead[PRIORITY_COUNT];
+    Transfer * volatile qtail[PRIORITY_COUNT];
+    Transfer * volatile cur;         // transfer in progress
+    uint32_t            cfg_reg;     // "cache" of CONFIG_REG
+    uint32_t            def_cfg;     // init() configuration
+    uint32_t            dly_reg;     // "cache" of DELAY_REG
+    const SpiDevice    *cur_dev;     // device CONFIG_REG is set up for
+    uint32_t            batch;       // transfers to cur_dev in a row
+    uint32_t            txed;        // bytes of current transfer pushed to TX FIFO
+    uint32_t            rxed;        // bytes of current transfer received
+    uint32_t            thres;       // current RX threshold
+};
+//------------------------------------------------------------------------------
+//
+//    SPI slave device: chip select, clock mode and divider, DELAY_REG image
+//    (nSS-to-clock, between words, between transfers delays), priority class
+//
+class SpiDevice
+{
+public:
+    constexpr SpiDevice(const uint32_t             cs,
+                        const SpiMaster::Mode      mode,
+                        const uint32_t             div,
+                        const SpiMaster::Priority  pr    = SpiMaster::prNORMAL,
+                        const uint32_t             delay = 0)
+        : cfg( (SpiMaster::config(mode, div) & ~SPI_CS_MASK) | ((~(1ul << cs) & SpiMaster::CS_NONE) << SPI_CS_BPOS) )
+        , dly(delay)
+        , prio(pr)
+    {
+    }
+
+    uint32_t            config()   const { return cfg;  }     // nCS asserted
+    uint32_t            delay()    const { return dly;  }
+    SpiMaster::Priority priority() const { return prio; }
+
+private:
+    const uint32_t            cfg;
+    const uint32_t            dly;
+    const SpiMaster::Priority prio;
+};
+//------------------------------------------------------------------------------
+
+#endif  // PS7SPIMASTER_H
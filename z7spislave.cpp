@@ -0,0 +1,197 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi SPI Slave Driver Source
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#include <z7int.h>
+#include <z7spislave.h>
+
+//------------------------------------------------------------------------------
+bool SpiSlave::init(const Mode        mode,
+                    void             *buf0,
+                    void             *buf1,
+                    const uint32_t    size,
+                    callback_t        callback,
+                    void             *ctx,
+                    const uint32_t    idle_count)
+{
+    if(!size || !buf0 || !buf1)
+        return false;
+
+    regs->EN_REG      = 0;
+    regs->INT_DIS_REG = 0xffffffff;
+
+    buf[0]     = reinterpret_cast<uint8_t *>(buf0);
+    buf[1]     = reinterpret_cast<uint8_t *>(buf1);
+    frame_size = size;
+    cb         = callback;
+    cb_ctx     = ctx;
+    cur        = 0;
+    last       = NONE;
+    ready      = 0;
+    pos        = 0;
+
+    regs->CONFIG_REG = (mode & 2 ? SPI_CLK_POL_MASK : 0) +       // MODE_SEL = 0: slave
+                       (mode & 1 ? SPI_CLK_PH_MASK  : 0);
+    regs->SLAVE_IDLE_COUNT_REG = idle_count;
+    regs->TX_THRES_REG         = 1;
+    set_thres();
+
+    regs->INT_STS_REG = SPI_INT_STS_RX_OVERFLOW_MASK | SPI_INT_STS_TX_FIFO_UNDERFLOW_MASK;
+    regs->EN_REG      = 1;
+    regs->INT_EN_REG  = SPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK | SPI_INT_STS_RX_OVERFLOW_MASK;
+
+    return true;
+}
+//------------------------------------------------------------------------------
+uint8_t *SpiSlave::frame() const
+{
+    const uint32_t READY = ready;
+
+    if(!READY)
+        return 0;
+
+    if(READY == 3)                           // both held: the older one first
+        return buf[last ^ 1];
+
+    return buf[READY == 1 ? 0 : 1];
+}
+//------------------------------------------------------------------------------
+//
+//    The buffer is taken for filling at the next frame boundary
+//
+void SpiSlave::release(const uint8_t *frame)
+{
+    CritSect cs;
+
+    for(uint32_t i = 0; i < 2; ++i)
+    {
+        if(buf[i] == frame)
+        {
+            ready &= ~(1ul << i);
+        }
+    }
+}
+//------------------------------------------------------------------------------
+void SpiSlave::resync()
+{
+    CritSect cs;
+
+    regs->RX_THRES_REG = 1;                  // NOT_EMPTY means level >= threshold
+    while(regs->INT_STS_REG & SPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK)
+    {
+        regs->RX_DATA_REG;
+    }
+    pos = 0;
+    cur = free_buf();
+    set_thres();
+}
+//------------------------------------------------------------------------------
+void SpiSlave::isr()
+{
+    const uint32_t STS = regs->INT_STS_REG;
+
+    if(STS & SPI_INT_STS_RX_OVERFLOW_MASK)
+    {
+        regs->INT_STS_REG = SPI_INT_STS_RX_OVERFLOW_MASK;
+        ++ovr_count;
+    }
+
+    if( !(STS & SPI_INT_STS_RX_FIFO_NOT_EMPTY_MASK) )
+        return;
+
+    //  RX FIFO holds at least 'thres' bytes
+    const uint32_t N = thres;
+    if(cur != NONE)
+    {
+        uint8_t *dst = buf[cur] + pos;
+        for(uint32_t i = 0; i < N; ++i)
+        {
+            dst[i] = regs->RX_DATA_REG;
+        }
+    }
+    else
+    {
+        for(uint32_t i = 0; i < N; ++i)
+        {
+            regs->RX_DATA_REG;
+        }
+    }
+    pos += N;
+
+    if(pos == frame_size)
+    {
+        pos = 0;
+        if(cur != NONE)
+        {
+            const uint32_t DONE = cur;
+
+            ready |= 1ul << DONE;
+            last   = DONE;
+            cur    = free_buf();
+            if(cb)
+            {
+                cb(cb_ctx, buf[DONE]);
+            }
+        }
+        else
+        {
+            ++drop_count;
+            cur = free_buf();
+        }
+    }
+
+    set_thres();
+}
+//------------------------------------------------------------------------------
+void SpiSlave::set_thres()
+{
+    const uint32_t REST = frame_size - pos;
+
+    thres = REST < CHUNK ? REST : CHUNK;
+    regs->RX_THRES_REG = thres;
+}
+//------------------------------------------------------------------------------
+//
+//    Buffer for the next frame: the one after the last completed, NONE if
+//    both are held by the application
+//
+uint32_t SpiSlave::free_buf() const
+{
+    const uint32_t NEXT = last == NONE ? 0 : last ^ 1;
+
+    if( !(ready & (1ul << NEXT)) )
+        return NEXT;
+
+    if( !(ready & (1ul << (NEXT ^ 1))) )
+        return NEXT ^ 1;
+
+    return NONE;
+}
+//------------------------------------------------------------------------------
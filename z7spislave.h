@@ -0,0 +1,132 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi SPI Slave Driver Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7SPISLAVE_H
+#define PS7SPISLAVE_H
+
+#include "z7spi.h"
+
+//------------------------------------------------------------------------------
+//
+//    Interrupt-driven SPI slave receiver
+//
+//    Notes:
+//    ~~~~~
+//    Data is received in frames of fixed size directly into two buffers owned
+//    by the user's software, there is no intermediate copy. When a frame is
+//    complete, the buffer is handed to the application (callback from ISR
+//    and/or polling by frame()) and the other buffer is filled with the next
+//    frame. The application returns the buffer by release(). If both buffers
+//    are held by the application, the incoming frame is dropped and counted
+//    by dropped().
+//
+//    RX threshold is set to CHUNK bytes (or the rest of the frame), the ISR
+//    reads exactly the threshold number of bytes without polling FIFO status,
+//    so the ISR latency budget is FIFO_SIZE - CHUNK byte times.
+//
+//    The controller detects transfer start after SCLK has been idle for
+//    SLAVE_IDLE_COUNT_REG reference clock cycles. The driver does not see
+//    nSS, so frame boundaries are kept by byte count; resync() drops the
+//    partially received frame (say, after master abort).
+//
+//    Transmit is not used: slave sends zeros (TX FIFO underflow).
+//
+class SpiSlave : public Spi
+{
+public:
+    typedef void (*callback_t)(void *ctx, uint8_t *frame);
+
+    enum Mode : uint8_t              // CPOL/CPHA
+    {
+        MODE0 = 0,
+        MODE1 = 1,
+        MODE2 = 2,
+        MODE3 = 3
+    };
+
+    static const uint32_t CHUNK = FIFO_SIZE/2;
+
+public:
+    SpiSlave(const uintptr_t addr) : Spi(addr)
+                                   , frame_size(0)
+                                   , cb(0)
+                                   , cb_ctx(0)
+                                   , cur(NONE)
+                                   , last(NONE)
+                                   , ready(0)
+                                   , pos(0)
+                                   , thres(0)
+                                   , drop_count(0)
+                                   , ovr_count(0)
+    {
+        buf[0] = 0;
+        buf[1] = 0;
+    }
+
+    bool init(const Mode        mode,     // false: zero size or null buffer
+              void             *buf0,
+              void             *buf1,
+              const uint32_t    size,
+              callback_t        callback = 0,
+              void             *ctx      = 0,
+              const uint32_t    idle_count = 0xff);
+
+    uint8_t *frame() const;                 // the oldest completed frame, 0 if none
+    void     release(const uint8_t *frame);
+    void     resync();
+
+    uint32_t dropped()   const { return drop_count; }
+    uint32_t overflows() const { return ovr_count;  }
+
+    void isr();
+
+private:
+    static const uint32_t NONE = 2;         // no buffer: frame is being dropped
+
+    void     set_thres();
+    uint32_t free_buf() const;
+
+private:
+    uint8_t           *buf[2];
+    uint32_t           frame_size;
+    callback_t         cb;
+    void              *cb_ctx;
+    volatile uint32_t  cur;                 // buffer being filled
+    volatile uint32_t  last;                // buffer completed last
+    volatile uint32_t  ready;               // bit mask of buffers held by the application
+    uint32_t           pos;                 // bytes of the current frame received
+    uint32_t           thres;
+    volatile uint32_t  drop_count;
+    volatile uint32_t  ovr_count;
+};
+//------------------------------------------------------------------------------
+
+#endif  // PS7SPISLAVE_H
@@ -35,6 +35,7 @@
 #include <stdint.h>
 #include <ps7mmrs.h>
 #include <z7common.h>
+#include <z7dmac.h>
 
 //------------------------------------------------------------------------------
 class Uart
@@ -60,10 +61,26 @@ public:
         uint32_t TX_FIFO_TRG_LVL;    //  32    mixed    0x00000020    Transmitter FIFO Trigger Level Register
     };
 
+    //--------------------------------------------------------------------------
+    //
+    //    Baud rate: baud = ref_clk/(CD*(BDIV + 1)), CD = 1..65535, BDIV = 4..255
+    //
+    struct BaudCfg
+    {
+        uint32_t cd;                 // BAUD_RATE_GEN
+        uint32_t bdiv;               // BAUD_RATE_DIVIDER
+        uint32_t baud;               // actual baud rate
+    };
+
+    static const uint32_t MODE_8N1           = 0x20;    // 8 data bits, no parity, 1 stop bit
+    static const uint32_t FLOW_DELAY_DEFAULT = 60;      // RX FIFO level to deassert RTS
+
 public:
     Uart(uintptr_t addr)
            : regs( reinterpret_cast<Regs*>(addr) )
            , busy(false)
+           , dma(0)
+           , dma_ch(0)
     { 
     }
     
@@ -82,13 +99,146 @@ public:
     void reset_rx_trig_int()    const { regs->CHNL_INT_STS = UART_CHNL_INT_STS_RTRIG_MASK; }
     char pop_rx()               const { return regs->TX_RX_FIFO; }
 
+    //--------------------------------------------------------------------------
+    //
+    //    RX FIFO trigger level, bytes: 1..63, 0 disables RTRIG
+    //
+    void set_rx_trigger(const uint32_t level) const { regs->RX_FIFO_TRG_LVL = level < FIFO_SIZE ? level : FIFO_SIZE - 1; }
+    uint32_t rx_trigger()                     const { return regs->RX_FIFO_TRG_LVL; }
+
+    //--------------------------------------------------------------------------
+    //
+    //    RX timeout in character times: the register counts in units of
+    //    4 bit periods, 'char_bits' is frame length (10 for 8N1). Max is 255
+    //    units (102 characters of 8N1), 0 disables the timeout
+    //
+    void set_rx_timeout(const uint32_t chars, const uint32_t char_bits = 10) const
+    {
+        const uint32_t RTO = (chars*char_bits + 3)/4;
+
+        regs->RX_TIMEOUT = RTO < 255 ? RTO : 255;
+        regs->CTRL      |= UART_CTRL_RSTTO_MASK;
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    //    DMA transmit: DMA controller moves data to TX FIFO by FIFO_SIZE chunks,
+    //    each chunk is started from UART ISR by dma_tx_isr() when TX FIFO
+    //    becomes empty
+    //
+    bool write_dma(Dmac &d, const uint32_t ch, const void *src, const uint32_t count,
+                   Dmac::callback_t cb, void *ctx)
+    {
+        if(!d.to_fifo(ch, &regs->TX_RX_FIFO, src, count, FIFO_SIZE, dma_tx_pace, this, cb, ctx))
+            return false;
+
+        dma    = &d;
+        dma_ch = ch;
+        clear_tx_empty_flag();
+        enable_tx_empty_int();
+        return true;
+    }
+
+    // to be called from UART ISR, returns true if TX empty event is consumed
+    bool dma_tx_isr()
+    {
+        if(!dma || !dma->busy(dma_ch) || !tx_empty())
+            return false;
+
+        disable_tx_empty_int();
+        clear_tx_empty_flag();
+        dma->kick(dma_ch);
+        return true;
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    //    Divisor pair with minimal baud rate error. Being constexpr, it is
+    //    evaluated at compile time for constant arguments, the error can be
+    //    checked by static_assert:
+    //
+    //        constexpr Uart::BaudCfg BAUD = Uart::baud_cfg(100000000, 921600);
+    //        static_assert(BAUD.baud > 921600*99/100 && BAUD.baud < 921600*101/100, "baud error");
+    //        uart.init(BAUD, true);
+    //
+    static constexpr BaudCfg baud_cfg(const uint32_t ref_clk, const uint32_t baud)
+    {
+        BaudCfg  best     = { 0, 0, 0 };
+        uint32_t best_err = 0xffffffff;
+
+        for(uint32_t bdiv = 4; bdiv <= 255; ++bdiv)
+        {
+            const uint32_t DIV = baud*(bdiv + 1);
+            const uint32_t CD  = (ref_clk + DIV/2)/DIV;
+            if(CD < 1 || CD > 65535)
+                continue;
+
+            const uint32_t ACTUAL = ref_clk/(CD*(bdiv + 1));
+            const uint32_t ERR    = ACTUAL > baud ? ACTUAL - baud : baud - ACTUAL;
+            if(ERR < best_err)
+            {
+                best.cd   = CD;
+                best.bdiv = bdiv;
+                best.baud = ACTUAL;
+                best_err  = ERR;
+            }
+        }
+        return best;
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    //    Sets baud rate and frame format, resets FIFOs and enables the
+    //    transmitter and the receiver. Hardware flow control: RTS is
+    //    deasserted by the receiver when RX FIFO level reaches 'flow_delay'
+    //    (4..63), the transmitter stops while CTS is deasserted
+    //
+    void init(const BaudCfg &b, const bool flow = false, const uint32_t flow_delay = FLOW_DELAY_DEFAULT,
+              const uint32_t mode = MODE_8N1) const
+    {
+        regs->CTRL              = UART_CTRL_TXDIS_MASK | UART_CTRL_RXDIS_MASK;
+        regs->INT_DIS           = 0xffffffff;
+        regs->MODE              = mode;
+        regs->BAUD_RATE_GEN     = b.cd;
+        regs->BAUD_RATE_DIVIDER = b.bdiv;
+
+        if(flow)
+        {
+            regs->FLOW_DELAY = flow_delay < 4 ? 4 : (flow_delay < FIFO_SIZE ? flow_delay : FIFO_SIZE - 1);
+            regs->MODEM_CTRL = UART_MODEM_CTRL_FCM_MASK | UART_MODEM_CTRL_RTS_MASK | UART_MODEM_CTRL_DTR_MASK;
+        }
+        else
+        {
+            regs->FLOW_DELAY = 0;
+            regs->MODEM_CTRL = UART_MODEM_CTRL_RTS_MASK | UART_MODEM_CTRL_DTR_MASK;
+        }
+
+        regs->CTRL         = UART_CTRL_TXRES_MASK | UART_CTRL_RXRES_MASK;
+        while(regs->CTRL & (UART_CTRL_TXRES_MASK | UART_CTRL_RXRES_MASK)) { }
+        regs->CHNL_INT_STS = 0xffffffff;
+        regs->CTRL         = UART_CTRL_TXEN_MASK | UART_CTRL_RXEN_MASK | UART_CTRL_RSTTO_MASK;
+    }
+
+    bool cts() const { return regs->MODEM_STS & UART_MODEM_STS_CTS_MASK; }
+
+    static const uint32_t FIFO_SIZE = 64;
+
 protected:
+    static void dma_tx_pace(void *p)
+    {
+        Uart *uart = static_cast<Uart *>(p);
+        uart->clear_tx_empty_flag();
+        uart->enable_tx_empty_int();
+    }
+
     static const uint32_t UART0_RST_MASK = UART_RST_CTRL_UART0_REF_RST_MASK | UART_RST_CTRL_UART0_CPU1X_RST_MASK;
     static const uint32_t UART1_RST_MASK = UART_RST_CTRL_UART1_REF_RST_MASK | UART_RST_CTRL_UART1_CPU1X_RST_MASK;
         
 protected:
     volatile Regs  *regs;
     volatile bool   busy;
+    Dmac           *dma;
+    uint32_t        dma_ch;
 };
 //------------------------------------------------------------------------------
 
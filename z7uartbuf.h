@@ -0,0 +1,243 @@
+//------------------------------------------------------------------------------
+//
+//    Xilinx zynq-7000/arm-none-eabi Buffered UART Header
+//
+//    Version 1.0
+//
+//    Permission is hereby granted, free of charge, to any person obtaining
+//    a copy of this software and associated documentation files (the
+//    "Software"), to deal in the Software without restriction, including
+//    without limitation the rights to use, copy, modify, merge, publish,
+//    distribute, sublicense, and/or sell copies of the Software, and to
+//    permit persons to whom the Software is furnished to do so, subject to
+//    the following conditions:
+//
+//    The above copyright notice and this permission notice shall be included
+//    in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE  IS PROVIDED  "AS IS", WITHOUT  WARRANTY OF  ANY KIND,
+//    EXPRESS  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH
+//    THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//    Copyright (c) 2017-2024, Zynq-7000 Bare-metal Project
+//    -----------------------------------------------------
+//    Project sources: https://github.com/z7bm
+//
+//------------------------------------------------------------------------------
+
+#ifndef PS7UARTBUF_H
+#define PS7UARTBUF_H
+
+#include "z7uart.h"
+#include "z7ring.h"
+
+//------------------------------------------------------------------------------
+//
+//    Interrupt-driven buffered UART
+//
+//    Notes:
+//    ~~~~~
+//    write() and read() are non-blocking: they copy data to/from TX/RX ring
+//    buffers and return the number of bytes transferred. The rings are SPSC
+//    lock-free queues between the user's thread and isr(), so write() and
+//    read() must not be called from more than one context each.
+//
+//    TX: isr() refills TX FIFO on TEMPTY interrupt. After TEMPTY the whole
+//    FIFO is free, so up to FIFO_SIZE bytes are pushed without polling TFUL.
+//    TTRIG is not usable for refill: it flags TX FIFO level at or above the
+//    trigger, that is "FIFO is filled", not "FIFO is drained". The shift
+//    register still sends the last character when TEMPTY is raised, so the
+//    refill latency is hidden for ISR response under one character time.
+//    TEMPTY interrupt is enabled by write() and disabled by isr() when the
+//    TX ring is empty; the TEMPTY status is not cleared in this case, so the
+//    next write() gets the interrupt at once.
+//
+//    RX: isr() drains RX FIFO on RTRIG (FIFO level reached the trigger) and
+//    TIMEOUT (no characters for the timeout period with data in FIFO), so
+//    there is one interrupt per trigger level bytes instead of per byte. RX
+//    trigger level bytes are read without polling REMPTY. Bytes which do not
+//    fit into the RX ring and FIFO overruns are counted by rx_lost().
+//
+//    set_rx_trigger() and set_rx_timeout() (in character times) tune the
+//    interrupt rate. In adaptive mode the trigger level is doubled when RTRIG
+//    drain finds more data than the trigger (sustained stream) and halved on
+//    timeout (end of burst/idle line), within [min, max]. The upper limit
+//    leaves FIFO_SIZE - max characters for ISR latency: at 921600 baud 8 free
+//    entries give ~87 us.
+//
+//    Usage example:
+//
+//        BufUart<1024, 256> uart1(UART1_BASEADDR);
+//
+//        void uart1_isr() { uart1.isr(); }
+//        ...
+//        ps7_register_isr(uart1_isr, PS7IRQ_ID_UART1);
+//        gic_int_enable(PS7IRQ_ID_UART1);
+//        uart1.start();
+//        ...
+//        uart1.write(msg, len);
+//
+template<uint32_t TX_SIZE = 256, uint32_t RX_SIZE = 256>
+class BufUart : public Uart
+{
+public:
+    static const uint32_t RX_TRIG_DEFAULT    = 48;    // bytes
+    static const uint32_t RX_TIMEOUT_DEFAULT = 4;     // character times
+    static const uint32_t RX_TRIG_MIN        = 8;
+    static const uint32_t RX_TRIG_MAX        = 56;
+
+public:
+    BufUart(uintptr_t addr) : Uart(addr)
+                            , rx_trig_lvl(RX_TRIG_DEFAULT)
+                            , trig_min(0)
+                            , trig_max(0)
+                            , lost(0)
+    {
+    }
+
+    void start()
+    {
+        regs->INT_DIS      = 0xffffffff;
+        set_rx_trigger(rx_trig_lvl);
+        set_rx_timeout(RX_TIMEOUT_DEFAULT);
+        regs->CHNL_INT_STS = UART_CHNL_INT_STS_RTRIG_MASK | UART_CHNL_INT_STS_TIMEOUT_MASK | UART_CHNL_INT_STS_ROVR_MASK;
+        regs->INT_EN       = UART_INT_EN_RTRIG_MASK | UART_INT_EN_TIMEOUT_MASK | UART_INT_EN_ROVR_MASK;
+    }
+
+    //  RX trigger level must not be 0: RTRIG drain reads it without polling
+    void set_rx_trigger(const uint32_t level)
+    {
+        rx_trig_lvl = level ? (level < FIFO_SIZE ? level : FIFO_SIZE - 1) : 1;
+        Uart::set_rx_trigger(rx_trig_lvl);
+    }
+
+    //  'min' == 0 turns adaptive mode off
+    void set_adaptive(const uint32_t min = RX_TRIG_MIN, const uint32_t max = RX_TRIG_MAX)
+    {
+        trig_min = min;
+        trig_max = max < FIFO_SIZE ? max : FIFO_SIZE - 1;
+    }
+
+    uint32_t write(const void *data, const uint32_t count)
+    {
+        const uint32_t n = tx_ring.write(reinterpret_cast<const uint8_t *>(data), count);
+        if(n)
+        {
+            enable_tx_empty_int();
+        }
+        return n;
+    }
+
+    uint32_t read(void *dst, const uint32_t count)
+    {
+        return rx_ring.read(reinterpret_cast<uint8_t *>(dst), count);
+    }
+
+    uint32_t tx_free () const { return tx_ring.free();  }
+    uint32_t rx_count() const { return rx_ring.count(); }
+    bool     tx_done () const { return tx_ring.empty() && (regs->CHANNEL_STS & UART_CHANNEL_STS_TEMPTY_MASK); }
+    uint32_t rx_lost () const { return lost; }
+
+    void isr()
+    {
+        const uint32_t STS = regs->CHNL_INT_STS & regs->INT_MASK;
+
+        if(STS & (UART_CHNL_INT_STS_RTRIG_MASK | UART_CHNL_INT_STS_TIMEOUT_MASK | UART_CHNL_INT_STS_ROVR_MASK))
+        {
+            drain_rx(STS);
+        }
+
+        if(STS & UART_CHNL_INT_STS_TEMPTY_MASK)
+        {
+            fill_tx();
+        }
+    }
+
+protected:
+    void fill_tx()
+    {
+        if(tx_ring.empty())
+        {
+            disable_tx_empty_int();
+            return;
+        }
+
+        clear_tx_empty_flag();
+
+        uint8_t        chunk[FIFO_SIZE];
+        const uint32_t n = tx_ring.read(chunk, FIFO_SIZE);
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            regs->TX_RX_FIFO = chunk[i];
+        }
+    }
+
+    void drain_rx(const uint32_t sts)
+    {
+        uint8_t  chunk[FIFO_SIZE];
+        uint32_t n = 0;
+
+        if(sts & UART_CHNL_INT_STS_RTRIG_MASK)        // at least trigger level bytes
+        {
+            for( ; n < rx_trig_lvl; ++n)
+            {
+                chunk[n] = regs->TX_RX_FIFO;
+            }
+        }
+        while( n < FIFO_SIZE && !(regs->CHANNEL_STS & UART_CHANNEL_STS_REMPTY_MASK) )
+        {
+            chunk[n++] = regs->TX_RX_FIFO;
+        }
+
+        lost += n - rx_ring.write(chunk, n);
+
+        if(trig_min)
+        {
+            adapt(sts, n);
+        }
+
+        if(sts & UART_CHNL_INT_STS_ROVR_MASK)
+        {
+            ++lost;
+        }
+        if(sts & UART_CHNL_INT_STS_TIMEOUT_MASK)
+        {
+            regs->CTRL |= UART_CTRL_RSTTO_MASK;       // restart timeout counter
+        }
+        regs->CHNL_INT_STS = sts & (UART_CHNL_INT_STS_RTRIG_MASK | UART_CHNL_INT_STS_TIMEOUT_MASK | UART_CHNL_INT_STS_ROVR_MASK);
+    }
+
+    void adapt(const uint32_t sts, const uint32_t n)
+    {
+        uint32_t lvl = rx_trig_lvl;
+
+        if( (sts & UART_CHNL_INT_STS_RTRIG_MASK) && n > lvl )
+        {
+            lvl = 2*lvl < trig_max ? 2*lvl : trig_max;
+        }
+        else if( !(sts & UART_CHNL_INT_STS_RTRIG_MASK) && (sts & UART_CHNL_INT_STS_TIMEOUT_MASK) )
+        {
+            lvl = lvl/2 > trig_min ? lvl/2 : trig_min;
+        }
+
+        if(lvl != rx_trig_lvl)
+        {
+            set_rx_trigger(lvl);
+        }
+    }
+
+protected:
+    RingBuffer<uint8_t, TX_SIZE> tx_ring;
+    RingBuffer<uint8_t, RX_SIZE> rx_ring;
+    uint32_t                     rx_trig_lvl;      // bytes, RX_FIFO_TRG_LVL image
+    uint32_t                     trig_min;         // adaptive mode limits, 0: off
+    uint32_t                     trig_max;
+    volatile uint32_t            lost;
+};
+//------------------------------------------------------------------------------
+
+#endif // PS7UARTBUF_H